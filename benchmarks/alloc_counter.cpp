@@ -0,0 +1,41 @@
+// Replacement global allocation functions that count calls and bytes, so
+// benchmarks can report allocations per operation.
+#include "bench.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<std::size_t> allocations{0};
+std::atomic<std::size_t> bytes{0};
+
+void *countedAlloc(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+} // namespace
+
+caskell::bench::AllocStats caskell::bench::allocStats() {
+  return {allocations.load(std::memory_order_relaxed),
+          bytes.load(std::memory_order_relaxed)};
+}
+
+void *operator new(std::size_t size) { return countedAlloc(size); }
+void *operator new[](std::size_t size) { return countedAlloc(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return countedAlloc(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return operator new(size, std::nothrow);
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
@@ -0,0 +1,97 @@
+#pragma once
+#ifndef CASKELL_BENCH_HPP
+#define CASKELL_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace caskell::bench {
+
+// Counters maintained by the replacement operator new in alloc_counter.cpp.
+struct AllocStats {
+  std::size_t allocations = 0;
+  std::size_t bytes = 0;
+};
+AllocStats allocStats();
+
+// Keeps the optimizer from discarding a computed value.
+template <typename T> inline void keep(const T &value) {
+#if defined(__GNUC__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void *sink;
+  sink = &value;
+#endif
+}
+
+struct Result {
+  std::string group;   // what is being measured, e.g. "lazystream/map_filter"
+  std::string variant; // "caskell" or "baseline"
+  std::size_t elements;
+  std::size_t iterations;
+  double nsPerElement;
+  double allocationsPerOp;
+  double bytesPerOp;
+};
+
+class Runner {
+  std::vector<Result> results_;
+  std::string filter_;
+  double minSeconds_;
+
+public:
+  explicit Runner(std::string filter = {}, double minSeconds = 0.2)
+      : filter_(std::move(filter)), minSeconds_(minSeconds) {}
+
+  // Runs op (one operation over `elements` elements) repeatedly for at least
+  // minSeconds and records time and allocation counts per operation.
+  template <typename Op>
+  void run(const std::string &group, const std::string &variant,
+           std::size_t elements, Op &&op) {
+    if (group.find(filter_) == std::string::npos)
+      return;
+    using Clock = std::chrono::steady_clock;
+    op(); // warm-up
+    std::size_t iterations = 0;
+    AllocStats before = allocStats();
+    auto start = Clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+      op();
+      ++iterations;
+      elapsed = Clock::now() - start;
+    } while (elapsed.count() < minSeconds_);
+    AllocStats after = allocStats();
+    results_.push_back(
+        {group, variant, elements, iterations,
+         elapsed.count() * 1e9 / (double(iterations) * std::max<std::size_t>(
+                                                          1, elements)),
+         double(after.allocations - before.allocations) / iterations,
+         double(after.bytes - before.bytes) / iterations});
+  }
+
+  void writeJson(std::FILE *out) const {
+    std::fprintf(out, "{\n  \"benchmarks\": [");
+    for (std::size_t i = 0; i < results_.size(); ++i) {
+      const Result &r = results_[i];
+      std::fprintf(out,
+                   "%s\n    {\"group\": \"%s\", \"variant\": \"%s\", "
+                   "\"elements\": %zu, \"iterations\": %zu, "
+                   "\"ns_per_element\": %.4f, \"allocations_per_op\": %.2f, "
+                   "\"bytes_per_op\": %.1f}",
+                   i == 0 ? "" : ",", r.group.c_str(), r.variant.c_str(),
+                   r.elements, r.iterations, r.nsPerElement,
+                   r.allocationsPerOp, r.bytesPerOp);
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+  }
+};
+
+} // namespace caskell::bench
+
+#endif // CASKELL_BENCH_HPP
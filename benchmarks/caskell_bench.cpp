@@ -0,0 +1,557 @@
+// Microbenchmarks comparing caskell constructs against hand-written loops.
+//
+// Usage: caskell_bench [group-filter] [min-seconds]
+// Prints a JSON document with one entry per (group, variant) pair.
+#include "bench.hpp"
+#include "caskell.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+using namespace caskell;
+using caskell::bench::keep;
+using caskell::bench::Runner;
+
+namespace {
+
+constexpr std::size_t N = 1 << 16;
+
+std::vector<int> iota(std::size_t n) {
+  std::vector<int> v(n);
+  std::iota(v.begin(), v.end(), 0);
+  return v;
+}
+
+void lazyStreamBenches(Runner &runner) {
+  const std::vector<int> data = iota(N);
+
+  runner.run("lazystream/map_filter_reduce", "caskell", N, [&] {
+    long sum = LazyStream(ContainerGenerator(data))
+                   .map([](int x) { return x * 3; })
+                   .filter([](int x) { return x % 2 == 0; })
+                   .reduce(0L, [](long acc, int x) { return acc + x; });
+    keep(sum);
+  });
+  runner.run("lazystream/map_filter_reduce", "baseline", N, [&] {
+    long sum = 0;
+    for (int x : data) {
+      int y = x * 3;
+      if (y % 2 == 0)
+        sum += y;
+    }
+    keep(sum);
+  });
+
+  runner.run("lazystream/range_take_collect", "caskell", N, [&] {
+    auto out = LazyStream(RangeGenerator<int>(0))
+                   .map([](int x) { return x + 1; })
+                   .take(N)
+                   .collect<std::vector<int>>();
+    keep(out.data());
+  });
+  runner.run("lazystream/range_take_collect", "baseline", N, [&] {
+    std::vector<int> out;
+    out.reserve(N);
+    for (int i = 0; i < static_cast<int>(N); ++i)
+      out.push_back(i + 1);
+    keep(out.data());
+  });
+}
+
+void streamBenches(Runner &runner) {
+  const std::vector<int> data = iota(N);
+
+  runner.run("stream/map_filter_reduce", "caskell", N, [&] {
+    long sum = stream(std::vector<int>(data))
+                   .map([](int x) { return x * 3L; })
+                   .filter([](long x) { return x % 2 == 0; })
+                   .reduce([](long acc, long x) { return acc + x; }, 0L);
+    keep(sum);
+  });
+  runner.run("stream/map_filter_reduce", "caskell_eager", N, [&] {
+    long sum = stream(std::vector<int>(data))
+                   .eager()
+                   .map([](int x) { return x * 3L; })
+                   .filter([](long x) { return x % 2 == 0; })
+                   .reduce([](long acc, long x) { return acc + x; }, 0L);
+    keep(sum);
+  });
+  runner.run("stream/map_filter_reduce", "baseline", N, [&] {
+    std::vector<int> v(data);
+    long sum = 0;
+    for (int x : v) {
+      int y = x * 3;
+      if (y % 2 == 0)
+        sum += y;
+    }
+    keep(sum);
+  });
+
+  runner.run("stream/map_filter_reduce", "caskell_par", N, [&] {
+    long sum = stream(std::vector<int>(data))
+                   .par()
+                   .map([](int x) { return x * 3L; })
+                   .filter([](long x) { return x % 2 == 0; })
+                   .reduce([](long acc, long x) { return acc + x; }, 0L);
+    keep(sum);
+  });
+
+  runner.run("stream/map_map_filter_collect", "caskell", N, [&] {
+    auto out = stream(std::vector<int>(data))
+                   .map([](int x) { return x + 1; })
+                   .map([](int x) { return x * 3; })
+                   .filter([](int x) { return x % 2 == 0; })
+                   .collect();
+    keep(out.data());
+  });
+  runner.run("stream/map_map_filter_collect", "baseline", N, [&] {
+    std::vector<int> v(data);
+    std::vector<int> out;
+    out.reserve(v.size());
+    for (int x : v) {
+      int y = (x + 1) * 3;
+      if (y % 2 == 0)
+        out.push_back(y);
+    }
+    keep(out.data());
+  });
+}
+
+void sortBenches(Runner &runner) {
+  std::vector<int> data(N);
+  for (std::size_t i = 0; i < N; ++i)
+    data[i] = static_cast<int>((i * 2654435761u) % 1000003) - 500000;
+  auto byValue = [](int x) { return x; };
+
+  runner.run("sort/sort_by_int", "caskell", N, [&] {
+    auto out = stream(std::vector<int>(data)).sortBy(byValue).collect();
+    keep(out.data());
+  });
+  runner.run("sort/sort_by_int", "baseline", N, [&] {
+    std::vector<int> out(data);
+    std::stable_sort(out.begin(), out.end());
+    keep(out.data());
+  });
+
+  runner.run("sort/top_k", "caskell", N, [&] {
+    auto out = stream(std::vector<int>(data)).topK(100, byValue).collect();
+    keep(out.data());
+  });
+  runner.run("sort/top_k", "caskell_lazy", N, [&] {
+    auto out = LazyStream(ContainerGenerator(data)).topK(100, byValue);
+    keep(out.data());
+  });
+  runner.run("sort/top_k", "baseline", N, [&] {
+    std::vector<int> out(data);
+    std::stable_sort(out.begin(), out.end());
+    out.resize(100);
+    keep(out.data());
+  });
+}
+
+void hashBenches(Runner &runner) {
+  std::vector<int> keys(N);
+  for (std::size_t i = 0; i < N; ++i)
+    keys[i] = static_cast<int>((i * 7919) % 4096);
+  auto sum = [](int a, int b) { return a + b; };
+  auto identity = [](int x) { return x; };
+
+  runner.run("hash/reduce_by_key", "caskell", N, [&] {
+    auto out = stream(std::vector<int>(keys))
+                   .reduceByKey(identity, sum)
+                   .collect();
+    keep(out.data());
+  });
+  runner.run("hash/reduce_by_key", "baseline", N, [&] {
+    std::vector<int> copy(keys);
+    std::unordered_map<int, int> totals;
+    for (int x : copy) {
+      auto [it, inserted] = totals.try_emplace(x, x);
+      if (!inserted)
+        it->second += x;
+    }
+    keep(totals.size());
+  });
+}
+
+struct Order {
+  long id;
+  double price;
+  int quantity;
+  double fees[9];
+};
+
+void soaBenches(Runner &runner) {
+  std::vector<Order> records(N);
+  for (std::size_t i = 0; i < N; ++i) {
+    records[i].id = static_cast<long>(i);
+    records[i].price = static_cast<double>(i % 89);
+    records[i].quantity = static_cast<int>(i % 13);
+  }
+  using Orders = SoA<Order, &Order::id, &Order::price, &Order::quantity>;
+  const Orders columns = Orders::fromAoS(records);
+
+  runner.run("soa/filter_project_sum", "caskell_soa", N, [&] {
+    double sum = stream(Orders(columns))
+                     .filter([](const auto &o) {
+                       return get<&Order::quantity>(o) > 6;
+                     })
+                     .map([](const auto &o) { return get<&Order::price>(o); })
+                     .reduce(std::plus<>(), 0.0);
+    keep(sum);
+  });
+  runner.run("soa/filter_project_sum", "caskell_aos", N, [&] {
+    double sum = stream(std::vector<Order>(records))
+                     .filter([](const Order &o) { return o.quantity > 6; })
+                     .map([](const Order &o) { return o.price; })
+                     .reduce(std::plus<>(), 0.0);
+    keep(sum);
+  });
+  runner.run("soa/filter_project_sum", "baseline", N, [&] {
+    std::vector<Order> copy(records);
+    double sum = 0;
+    for (const Order &o : copy)
+      if (o.quantity > 6)
+        sum += o.price;
+    keep(sum);
+  });
+}
+
+void simdBenches(Runner &runner) {
+  std::vector<double> values(N);
+  for (std::size_t i = 0; i < N; ++i)
+    values[i] = static_cast<double>(i % 97) * 0.5;
+
+  runner.run("simd/double_sum", "caskell", N, [&] {
+    double sum = stream(std::vector<double>(values))
+                     .reduce(reassociate(ops::sum), 0.0);
+    keep(sum);
+  });
+  runner.run("simd/double_sum", "caskell_ordered", N, [&] {
+    double sum = stream(std::vector<double>(values))
+                     .reduce(std::plus<>(), 0.0);
+    keep(sum);
+  });
+  runner.run("simd/double_sum", "baseline", N, [&] {
+    std::vector<double> copy(values);
+    double sum = 0;
+    for (double x : copy)
+      sum += x;
+    keep(sum);
+  });
+
+  runner.run("simd/lazy_count_if", "caskell", N, [&] {
+    auto count = LazyStream(ContainerGenerator(values))
+                     .reduce(0L, ops::countIf(std::less<>(), 10.0));
+    keep(count);
+  });
+  runner.run("simd/lazy_count_if", "baseline", N, [&] {
+    long count = 0;
+    for (double x : values)
+      count += x < 10.0;
+    keep(count);
+  });
+}
+
+void listBenches(Runner &runner) {
+  constexpr std::size_t Size = 4096;
+  std::deque<int> values(Size);
+  std::iota(values.begin(), values.end(), 0);
+  const List<int> list(values);
+
+  runner.run("list/and_then", "caskell", Size * 2, [&] {
+    auto out = list.and_then([](int x) { return List<int>{x, -x}; });
+    keep(out.length());
+  });
+  runner.run("list/and_then", "caskell_arena", Size * 2, [&] {
+    ArenaScope scope;
+    auto out = list.and_then([](int x) { return ArenaList<int>{x, -x}; });
+    keep(out.length());
+  });
+  runner.run("list/and_then", "caskell_small", Size * 2, [&] {
+    auto out = list.and_then([](int x) { return SmallList<int>{x, -x}; });
+    keep(out.length());
+  });
+  runner.run("list/and_then", "baseline", Size * 2, [&] {
+    std::deque<int> out;
+    for (int x : values) {
+      out.push_back(x);
+      out.push_back(-x);
+    }
+    keep(out.size());
+  });
+
+  // Nested generators as in a list comprehension: from builds a list per
+  // element, lazyFrom streams the inner results into the final list.
+  const List<int> signs{1, -1};
+  runner.run("list/comprehension", "caskell", Size * 2, [&] {
+    auto out = list.from([&signs](int x) {
+      return signs.from([x](int s) { return pure(x * s); });
+    });
+    keep(out.length());
+  });
+  runner.run("list/comprehension", "caskell_lazy", Size * 2, [&] {
+    auto out = list.lazyFrom([&signs](int x) {
+                     return signs.lazyFrom([x](int s) { return pure(x * s); });
+                   })
+                   .toList();
+    keep(out.length());
+  });
+}
+
+template <typename L> long sumByTail(const L &xs) {
+  long sum = 0;
+  for (L rest = xs; !rest.null(); rest = rest.tail())
+    sum += rest.head();
+  return sum;
+}
+
+void listTailBenches(Runner &runner) {
+  constexpr std::size_t Size = 1024;
+  const auto deque = range(1, static_cast<int>(Size));
+  const auto cons = range<int, ConsStorage>(1, static_cast<int>(Size));
+  const auto finger = range<int, FingerStorage>(1, static_cast<int>(Size));
+
+  runner.run("list/tail_recursion", "caskell", Size,
+             [&] { keep(sumByTail(deque)); });
+  runner.run("list/tail_recursion", "caskell_cons", Size,
+             [&] { keep(sumByTail(cons)); });
+  runner.run("list/tail_recursion", "caskell_finger", Size,
+             [&] { keep(sumByTail(finger)); });
+}
+
+// Left-nested appends, as a Writer log accumulates: quadratic when + copies.
+template <typename L> std::size_t appendLeft(std::size_t size) {
+  L xs;
+  for (std::size_t i = 0; i < size; ++i)
+    xs = xs + L{static_cast<int>(i)};
+  return xs.length();
+}
+
+void listAppendBenches(Runner &runner) {
+  constexpr std::size_t Size = 1024;
+  runner.run("list/append_left", "caskell", Size,
+             [&] { keep(appendLeft<List<int>>(Size)); });
+  runner.run("list/append_left", "caskell_finger", Size,
+             [&] { keep(appendLeft<FingerList<int>>(Size)); });
+}
+
+void showBenches(Runner &runner) {
+  constexpr std::size_t Rows = 1024;
+  std::deque<List<int>> rows;
+  for (std::size_t i = 0; i < Rows; ++i)
+    rows.push_back(range(static_cast<int>(i), static_cast<int>(i) + 7));
+  const List<List<int>> boards(rows);
+
+  runner.run("show/nested_lists", "caskell", Rows * 8,
+             [&] { keep(Show<List<List<int>>>::show(boards).size()); });
+  std::string buffer;
+  runner.run("show/nested_lists", "caskell_buffer", Rows * 8, [&] {
+    buffer.clear();
+    keep(showTo(boards, buffer).size());
+  });
+  // A string per element and per row, concatenated.
+  runner.run("show/nested_lists", "baseline", Rows * 8, [&] {
+    std::string result = "[";
+    for (const auto &row : boards) {
+      std::string inner = "[";
+      for (int x : row)
+        inner += std::to_string(x) + ", ";
+      inner.resize(inner.size() - 2);
+      result += inner + "], ";
+    }
+    result.resize(result.size() - 2);
+    result += "]";
+    keep(result.size());
+  });
+}
+
+void maybeBenches(Runner &runner) {
+  const std::vector<int> data = iota(N);
+  auto half = [](int x) { return x % 2 == 0 ? pure(x / 2) : nothing<int>(); };
+
+  runner.run("maybe/chain", "caskell", N, [&] {
+    long sum = 0;
+    for (int x : data)
+      sum += (Maybe<int>(x) >>= half)
+                 .map([](int y) { return y + 1; })
+                 .value_or(0);
+    keep(sum);
+  });
+  runner.run("maybe/chain", "baseline", N, [&] {
+    long sum = 0;
+    for (int x : data)
+      sum += x % 2 == 0 ? x / 2 + 1 : 0;
+    keep(sum);
+  });
+
+  // Ten steps over a 1 MB payload: the rvalue chain moves it throughout,
+  // the lvalue chain copies it at every step.
+  auto grow = [](std::vector<char> bytes) {
+    ++bytes[0];
+    return bytes;
+  };
+  runner.run("maybe/large_chain", "caskell", 10, [&] {
+    auto m = Maybe<std::vector<char>>(std::vector<char>(1 << 20));
+    for (int i = 0; i < 10; ++i)
+      m = std::move(m).map(grow);
+    keep((*m)[0]);
+  });
+  runner.run("maybe/large_chain", "caskell_lvalue", 10, [&] {
+    auto m = Maybe<std::vector<char>>(std::vector<char>(1 << 20));
+    for (int i = 0; i < 10; ++i)
+      m = m.map(grow);
+    keep((*m)[0]);
+  });
+
+  // A large array of optional doubles: the niche halves its footprint.
+  constexpr std::size_t Count = std::size_t(1) << 22;
+  std::vector<Maybe<double>> dense(Count);
+  std::vector<std::optional<double>> wide(Count);
+  for (std::size_t i = 0; i < Count; i += 3) {
+    dense[i] = Maybe<double>(static_cast<double>(i));
+    wide[i] = static_cast<double>(i);
+  }
+  runner.run("maybe/array_sum", "caskell", Count, [&] {
+    double sum = 0;
+    for (const auto &x : dense)
+      sum += x.value_or(0.0);
+    keep(sum);
+  });
+  runner.run("maybe/array_sum", "baseline", Count, [&] {
+    double sum = 0;
+    for (const auto &x : wide)
+      sum += x.value_or(0.0);
+    keep(sum);
+  });
+}
+
+void curryBenches(Runner &runner) {
+  const std::vector<int> data = iota(N);
+  auto add3 = [](int a, int b, int c) { return a + b + c; };
+
+  runner.run("curry/partial_apply", "caskell", N, [&] {
+    long sum = 0;
+    auto f = curry(add3);
+    for (int x : data)
+      sum += f(x)(1)(2);
+    keep(sum);
+  });
+  runner.run("curry/partial_apply", "baseline", N, [&] {
+    long sum = 0;
+    for (int x : data)
+      sum += add3(x, 1, 2);
+    keep(sum);
+  });
+}
+
+struct Circle {
+  int r;
+};
+struct Square {
+  int side;
+};
+using Shape = std::variant<Circle, Square>;
+
+void matchBenches(Runner &runner) {
+  constexpr std::size_t Size = 4096;
+  const std::vector<int> data = iota(Size);
+
+  runner.run("match/value", "caskell", Size, [&] {
+    long sum = 0;
+    for (int x : data) {
+      int r = match(x % 4) | (value(0) >> [](int) { return 10; })
+              | (value(1) >> [](int) { return 20; })
+              | (_ >> [](int v) { return v; });
+      sum += r;
+    }
+    keep(sum);
+  });
+  runner.run("match/value", "baseline", Size, [&] {
+    long sum = 0;
+    for (int x : data) {
+      switch (x % 4) {
+      case 0:
+        sum += 10;
+        break;
+      case 1:
+        sum += 20;
+        break;
+      default:
+        sum += x % 4;
+      }
+    }
+    keep(sum);
+  });
+
+  runner.run("match/multi_guard", "caskell", Size, [&] {
+    long sum = 0;
+    for (int x : data) {
+      int r = match(x, x + 1)
+              | (guard([](int a, int) { return a % 3 == 0; })
+                 >> [](int a, int b) { return a * b; })
+              | (_ >> [](int a, int b) { return a + b; });
+      sum += r;
+    }
+    keep(sum);
+  });
+  runner.run("match/multi_guard", "baseline", Size, [&] {
+    long sum = 0;
+    for (int x : data)
+      sum += x % 3 == 0 ? x * (x + 1) : x + (x + 1);
+    keep(sum);
+  });
+
+  std::vector<Shape> shapes;
+  for (int x : data)
+    shapes.push_back(x % 2 ? Shape(Circle{x}) : Shape(Square{x}));
+
+  runner.run("match/variant", "caskell", Size, [&] {
+    long sum = 0;
+    for (const Shape &s : shapes) {
+      int r = match(s) | type<Circle>() >> [](const Circle &c) { return c.r; }
+              | type<Square>() >> [](const Square &q) { return 2 * q.side; };
+      sum += r;
+    }
+    keep(sum);
+  });
+  runner.run("match/variant", "baseline", Size, [&] {
+    long sum = 0;
+    for (const Shape &s : shapes) {
+      if (auto *c = std::get_if<Circle>(&s))
+        sum += c->r;
+      else
+        sum += 2 * std::get<Square>(s).side;
+    }
+    keep(sum);
+  });
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Runner runner(argc > 1 ? argv[1] : "",
+                argc > 2 ? std::strtod(argv[2], nullptr) : 0.2);
+  lazyStreamBenches(runner);
+  streamBenches(runner);
+  simdBenches(runner);
+  soaBenches(runner);
+  hashBenches(runner);
+  sortBenches(runner);
+  listBenches(runner);
+  listTailBenches(runner);
+  listAppendBenches(runner);
+  showBenches(runner);
+  maybeBenches(runner);
+  curryBenches(runner);
+  matchBenches(runner);
+  runner.writeJson(stdout);
+  return 0;
+}
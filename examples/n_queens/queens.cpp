@@ -3,13 +3,17 @@
 
 using namespace caskell;
 
+// Boards are cons lists, so the recursion on qs.tail() shares cells
+// instead of copying the rest of the board at every step.
+using Board = ConsList<int>;
+
 // safe :: Int -> [Int] -> Int -> Bool
-const auto safe = curry([](int x, const List<int> &qs, int y) {
-  auto safe_rec = make_y_combinator([](auto self, int x, const List<int> &qs,
+const auto safe = curry([](int x, const Board &qs, int y) {
+  auto safe_rec = make_y_combinator([](auto self, int x, const Board &qs,
                                        int y) -> bool {
     return match(qs)
-           | (value(List<int>()) >> [](const List<int> &) { return true; })
-           | (_ >> [&self, x, y](const List<int> &qs) {
+           | (value(Board()) >> [](const Board &) { return true; })
+           | (_ >> [&self, x, y](const Board &qs) {
                return x != qs.head()
                       && std::abs(x - qs.head())
                              != std::abs(y - static_cast<int>(qs.length() - 1))
@@ -20,23 +24,26 @@ const auto safe = curry([](int x, const List<int> &qs, int y) {
 });
 
 // queens :: Int -> List [Int]
-const auto queens = make_y_combinator([](auto self, int n) -> List<List<int>> {
+const auto queens = make_y_combinator([](auto self, int n) -> List<Board> {
   return match(n)
-         | (value(0) >> [](int) { return List<List<int>>({List<int>()}); })
+         | (value(0) >> [](int) { return List<Board>({Board()}); })
          | (_ >> [&self](int n) {
-             return self(n - 1).from([n](const List<int> &qs) {
-               return range(1, 8).from([n, qs](int q) {
-                 return safe(q)(qs)(n - 1) ? List<List<int>>({q | qs})
-                                           : List<List<int>>();
-               });
-             });
+             static const auto columns = range(1, 8);
+             return self(n - 1)
+                 .lazyFrom([n](const Board &qs) {
+                   return columns.lazyFrom([n, &qs](int q) {
+                     return safe(q)(qs)(n - 1) ? pure(q | qs)
+                                               : nothing<Board>();
+                   });
+                 })
+                 .toList();
            });
 });
 
 int main() {
   auto solutions = queens(8);
   std::cout << "Solutions: " << std::endl; 
-  std::cout << Show<List<List<int>>>::show(solutions) << "\n";
+  showTo(solutions, std::cout) << "\n";
   std::cout << "Number of solutions: " << solutions.length() << std::endl;
   return 0;
 }
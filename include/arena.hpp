@@ -0,0 +1,121 @@
+#pragma once
+#ifndef CASKELL_ARENA_HPP
+#define CASKELL_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace caskell {
+namespace impl {
+
+// The arena of the innermost ArenaScope open on this thread, or nullptr.
+inline std::pmr::memory_resource *&currentArena() {
+  static thread_local std::pmr::memory_resource *arena = nullptr;
+  return arena;
+}
+
+} // namespace impl
+
+// Opens a bump-pointer arena for the current thread. While the scope is
+// alive, ArenaAllocators default-constructed on this thread (and through
+// them the intermediates of List and Stream) allocate from the arena;
+// deallocation is a no-op and all memory is released at once when the
+// scope ends. Scopes nest and must be closed in reverse order of opening.
+//
+// Anything still holding arena memory must be gone before the scope ends.
+// Copy results out: a copy takes the allocator current at the point of
+// copying, whereas a move keeps the arena memory.
+class ArenaScope {
+public:
+  explicit ArenaScope(
+      std::size_t initialSize = 4096,
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+      : arena_(initialSize, upstream), previous_(impl::currentArena()) {
+    impl::currentArena() = &arena_;
+  }
+
+  // Serves allocations from buffer first, e.g. a stack array.
+  ArenaScope(
+      void *buffer, std::size_t size,
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+      : arena_(buffer, size, upstream), previous_(impl::currentArena()) {
+    impl::currentArena() = &arena_;
+  }
+
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope &operator=(const ArenaScope &) = delete;
+
+  ~ArenaScope() { impl::currentArena() = previous_; }
+
+  std::pmr::memory_resource *resource() { return &arena_; }
+
+private:
+  std::pmr::monotonic_buffer_resource arena_;
+  std::pmr::memory_resource *previous_;
+};
+
+// Allocates from the arena that was current on the constructing thread,
+// or from the heap when no ArenaScope was open. The arena is not
+// thread-safe: a container built from it must not grow on another thread.
+template <typename T> class ArenaAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  ArenaAllocator() noexcept : resource_(impl::currentArena()) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) noexcept
+      : resource_(other.resource()) {}
+
+  T *allocate(std::size_t n) {
+    if (resource_)
+      return static_cast<T *>(resource_->allocate(n * sizeof(T), alignof(T)));
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T *p, std::size_t n) noexcept {
+    if (resource_)
+      resource_->deallocate(p, n * sizeof(T), alignof(T));
+    else
+      std::allocator<T>().deallocate(p, n);
+  }
+
+  // Copies of a container go to the arena current at the copy, not to
+  // the one of the original.
+  ArenaAllocator select_on_container_copy_construction() const {
+    return ArenaAllocator();
+  }
+
+  std::pmr::memory_resource *resource() const noexcept { return resource_; }
+
+  template <typename U>
+  friend bool operator==(const ArenaAllocator &lhs,
+                         const ArenaAllocator<U> &rhs) noexcept {
+    return lhs.resource() == rhs.resource();
+  }
+
+  template <typename U>
+  friend bool operator!=(const ArenaAllocator &lhs,
+                         const ArenaAllocator<U> &rhs) noexcept {
+    return !(lhs == rhs);
+  }
+
+private:
+  std::pmr::memory_resource *resource_;
+};
+
+template <typename T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+using ArenaString
+    = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+} // namespace caskell
+
+#endif // CASKELL_ARENA_HPP
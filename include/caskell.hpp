@@ -2,10 +2,18 @@
 #ifndef CASKELL_HPP
 #define CASKELL_HPP
 
+#include "arena.hpp"            // IWYU pragma: keep
 #include "common_monads.hpp"    // IWYU pragma: keep
+#include "coroutine.hpp"        // IWYU pragma: keep
 #include "curry.hpp"            // IWYU pragma: keep
+#include "lazylist.hpp"         // IWYU pragma: keep
 #include "lazystream.hpp"       // IWYU pragma: keep
+#include "list_storage.hpp"     // IWYU pragma: keep
+#include "mapped_file.hpp"      // IWYU pragma: keep
 #include "pattern_matching.hpp" // IWYU pragma: keep
+#include "show.hpp"             // IWYU pragma: keep
+#include "simd.hpp"             // IWYU pragma: keep
+#include "soa.hpp"              // IWYU pragma: keep
 #include "stream.hpp"           // IWYU pragma: keep
 #include "typeclass.hpp"        // IWYU pragma: keep
 #include "utils.hpp"            // IWYU pragma: keep
@@ -2,18 +2,17 @@
 #ifndef CASKELL_MONAD_HPP
 #define CASKELL_MONAD_HPP
 
+#include "fusion.hpp"
+#include "list_storage.hpp"
+#include "show.hpp"
 #include "typeclass.hpp"
 #include <deque>
 #include <functional>
 #include <string>
+#include <utility>
 
 namespace caskell {
 
-// Show typeclass
-template <typename T> struct Show {
-  static std::string show(const T &x);
-};
-
 // Identity Monad
 template <typename T> class Identity {
 private:
@@ -27,29 +26,66 @@ public:
   const T &operator*() const { return value; }
   T &operator*() { return value; }
 
-  template <typename F> auto map(F &&f) const {
+  // On an rvalue the value is moved into f, and a result of the same type
+  // reuses this Identity.
+  template <typename F> auto map(F &&f) const & {
     return Identity<std::invoke_result_t<F, T>>(std::forward<F>(f)(value));
   }
 
+  template <typename F> auto map(F &&f) && {
+    using R = std::invoke_result_t<F, T>;
+    if constexpr (std::is_same_v<R, T>) {
+      value = std::forward<F>(f)(std::move(value));
+      return std::move(*this);
+    } else {
+      return Identity<R>(std::forward<F>(f)(std::move(value)));
+    }
+  }
+
   template <typename F>
-  auto and_then(F &&f) const -> std::invoke_result_t<F, T> {
+  auto and_then(F &&f) const & -> std::invoke_result_t<F, const T &> {
     return std::forward<F>(f)(value);
   }
+
+  template <typename F> auto and_then(F &&f) && -> std::invoke_result_t<F, T> {
+    return std::forward<F>(f)(std::move(value));
+  }
 };
 
-// List Monad (using std::deque as the container)
-template <typename T> class List {
-private:
-  std::deque<T> values;
+template <typename T, typename Storage> class List;
+
+template <typename Source, typename T, typename Stage> class Comprehension;
 
+// List Monad. Storage selects the representation (see list_storage.hpp):
+// DequeStorage, the default, keeps a std::deque; ArenaStorage keeps one
+// that allocates from the current ArenaScope; ConsStorage shares cons
+// cells between lists; SmallStorage<N> keeps up to N elements in place;
+// FingerStorage concatenates and splits in O(log n).
+template <typename T, typename Storage = DequeStorage> class List {
 public:
   using value_type = T;
-  using container_type = std::deque<T>;
+  using storage_type = Storage;
+  using container_type = typename Storage::template Container<T>;
+
+private:
+  container_type values;
+
+  // Whether elements can be moved out of an rvalue list; persistent
+  // storages share them and iterate as const.
+  static constexpr bool OwnsElements = !std::is_const_v<
+      std::remove_reference_t<decltype(*std::declval<container_type &>()
+                                            .begin())>>;
+
+public:
   using iterator = typename container_type::iterator;
   using const_iterator = typename container_type::const_iterator;
 
   List() = default;
   explicit List(container_type vals) : values(std::move(vals)) {}
+  template <typename C = container_type,
+            typename = std::enable_if_t<!std::is_same_v<C, std::deque<T>>>>
+  explicit List(const std::deque<T> &vals)
+      : values(vals.begin(), vals.end()) {}
   explicit List(T val) : values{std::move(val)} {}
   List(std::initializer_list<T> init) : values(init) {}
 
@@ -59,18 +95,8 @@ public:
   // Haskell-style list operations
   bool null() const { return values.empty(); }
   T head() const { return values.front(); }
-  List<T> tail() const {
-    if (values.empty())
-      return List<T>();
-    container_type new_values(std::next(values.begin()), values.end());
-    return List<T>(std::move(new_values));
-  }
-  List<T> init() const {
-    if (values.empty())
-      return List<T>();
-    container_type new_values(values.begin(), std::prev(values.end()));
-    return List<T>(std::move(new_values));
-  }
+  List tail() const { return List(Storage::tail(values)); }
+  List init() const { return List(Storage::init(values)); }
   T last() const { return values.back(); }
   size_t length() const { return values.size(); }
 
@@ -79,64 +105,227 @@ public:
   iterator end() { return values.end(); }
   const_iterator begin() const { return values.begin(); }
   const_iterator end() const { return values.end(); }
-  const_iterator cbegin() const { return values.cbegin(); }
-  const_iterator cend() const { return values.cend(); }
+  const_iterator cbegin() const { return values.begin(); }
+  const_iterator cend() const { return values.end(); }
 
   // cons :: a -> List a -> List a
-  static List<T> cons(const T &x, const List<T> &xs) {
-    auto result = xs.values;
-    result.push_front(x);
-    return List<T>(std::move(result));
+  static List cons(const T &x, const List &xs) {
+    return List(Storage::cons(x, xs.values));
   }
 
-  // Operator overloading for list construction (similar to Haskell's :)
-  friend List<T> operator|(const T &x, const List<T> &xs) {
-    return cons(x, xs);
+  // snoc :: List a -> a -> List a, appending one element
+  static List snoc(const List &xs, const T &x) {
+    return List(Storage::snoc(xs.values, x));
   }
 
+  // xs !! i
+  const T &operator[](size_t i) const { return Storage::index(values, i); }
+
+  // splitAt :: Int -> List a -> (List a, List a)
+  std::pair<List, List> splitAt(size_t n) const {
+    auto [front, back] = Storage::splitAt(values, n);
+    return {List(std::move(front)), List(std::move(back))};
+  }
+
+  // Operator overloading for list construction (similar to Haskell's :)
+  friend List operator|(const T &x, const List &xs) { return cons(x, xs); }
+
   // Equality comparison operator
-  friend bool operator==(const List<T> &lhs, const List<T> &rhs) {
+  friend bool operator==(const List &lhs, const List &rhs) {
     return lhs.values == rhs.values;
   }
 
   // Inequality comparison operator
-  friend bool operator!=(const List<T> &lhs, const List<T> &rhs) {
+  friend bool operator!=(const List &lhs, const List &rhs) {
     return !(lhs == rhs);
   }
 
-  template <typename F> auto map(F &&f) const {
+  template <typename F> auto map(F &&f) const & {
     using ResultType = std::invoke_result_t<F, T>;
-    std::deque<ResultType> result;
+    typename Storage::template Builder<ResultType> result;
     for (const auto &val : values) {
       result.push_back(std::forward<F>(f)(val));
     }
-    return List<ResultType>(std::move(result));
+    return List<ResultType, Storage>(std::move(result).finish());
+  }
+
+  // On an rvalue the elements are moved into f, unless the storage shares
+  // them, and a result of the same type is written over them in place.
+  template <typename F> auto map(F &&f) && {
+    using ResultType = std::invoke_result_t<F, T>;
+    if constexpr (std::is_same_v<ResultType, T> && OwnsElements) {
+      for (auto &val : values)
+        val = f(std::move(val));
+      return std::move(*this);
+    } else {
+      typename Storage::template Builder<ResultType> result;
+      for (auto &&val : values)
+        result.push_back(f(std::move(val)));
+      return List<ResultType, Storage>(std::move(result).finish());
+    }
   }
 
-  template <typename F> auto and_then(F &&f) const {
-    using ResultType = typename std::invoke_result_t<F, T>::value_type;
-    std::deque<ResultType> result;
+  // f may also return a Maybe or a pending Comprehension; the elements of
+  // each result are moved straight into the new list.
+  template <typename F> auto and_then(F &&f) const & {
+    using ResultType =
+        typename std::decay_t<std::invoke_result_t<F, const T &>>::value_type;
+    typename Storage::template Builder<ResultType> result;
     for (const auto &val : values) {
-      auto sublist = std::forward<F>(f)(val);
-      auto &subvalues = sublist.get();
-      result.insert(result.end(), subvalues.begin(), subvalues.end());
+      impl::expand(f(val), [&result](auto &&item) {
+        result.push_back(std::forward<decltype(item)>(item));
+      });
+    }
+    return List<ResultType, Storage>(std::move(result).finish());
+  }
+
+  template <typename F> auto and_then(F &&f) && {
+    using ResultType =
+        typename std::decay_t<std::invoke_result_t<F, T>>::value_type;
+    typename Storage::template Builder<ResultType> result;
+    for (auto &&val : values) {
+      impl::expand(f(std::move(val)), [&result](auto &&item) {
+        result.push_back(std::forward<decltype(item)>(item));
+      });
     }
-    return List<ResultType>(std::move(result));
+    return List<ResultType, Storage>(std::move(result).finish());
   }
 
   // from :: List a -> (a -> List b) -> List b
-  template <typename F> auto from(F &&f) const {
+  template <typename F> auto from(F &&f) const & {
     return and_then(std::forward<F>(f));
   }
 
+  template <typename F> auto from(F &&f) && {
+    return std::move(*this).and_then(std::forward<F>(f));
+  }
+
+  // Like from, but builds nothing until the Comprehension is converted to
+  // a List: nested lazyFrom, map and filter calls fuse into one generator
+  // whose output goes directly into the final list.
+  template <typename F> auto lazyFrom(F &&f) const & {
+    return comprehension<const List &>(*this).lazyFrom(std::forward<F>(f));
+  }
+
+  template <typename F> auto lazyFrom(F &&f) && {
+    return comprehension<List>(std::move(*this))
+        .lazyFrom(std::forward<F>(f));
+  }
+
   // Operator overloading for list concatenation (++)
-  List<T> operator+(const List<T> &other) const {
-    std::deque<T> result = values;
-    result.insert(result.end(), other.values.begin(), other.values.end());
-    return List<T>(std::move(result));
+  List operator+(const List &other) const {
+    return List(Storage::concat(values, other.values));
+  }
+
+private:
+  template <typename Source> static auto comprehension(Source source) {
+    return Comprehension<Source, T, impl::IdentityStage>(
+        std::forward<Source>(source), impl::IdentityStage{});
+  }
+};
+
+// A list comprehension that has not been run yet, made by List::lazyFrom.
+// It holds the source list (a reference when made from an lvalue, which
+// must then outlive it) and one fused stage; lazyFrom, map and filter add
+// stages, and toList() runs them into a List with the source's storage.
+// Inner generators may return Lists, Maybes or further Comprehensions,
+// which are consumed element by element without building a list for each.
+template <typename Source, typename T, typename Stage> class Comprehension {
+  using SourceList = std::decay_t<Source>;
+  using Storage = typename SourceList::storage_type;
+
+  Source source_;
+  Stage stage_;
+
+  template <typename U, typename NewStage>
+  Comprehension<Source, U, NewStage> with(NewStage stage) const & {
+    return {source_, std::move(stage)};
+  }
+
+  template <typename U, typename NewStage>
+  Comprehension<Source, U, NewStage> with(NewStage stage) && {
+    return {std::forward<Source>(source_), std::move(stage)};
+  }
+
+public:
+  using value_type = T;
+
+  Comprehension(Source source, Stage stage)
+      : source_(std::forward<Source>(source)), stage_(std::move(stage)) {}
+
+  template <typename F> auto lazyFrom(F &&f) const & {
+    using U = typename std::decay_t<std::invoke_result_t<F &, T>>::value_type;
+    return with<U>(impl::BindStage<Stage, std::decay_t<F>>{
+        stage_, std::forward<F>(f)});
+  }
+
+  template <typename F> auto lazyFrom(F &&f) && {
+    using U = typename std::decay_t<std::invoke_result_t<F &, T>>::value_type;
+    return std::move(*this).template with<U>(
+        impl::BindStage<Stage, std::decay_t<F>>{std::move(stage_),
+                                                std::forward<F>(f)});
+  }
+
+  template <typename F> auto map(F &&f) const & {
+    using U = std::decay_t<std::invoke_result_t<F &, T>>;
+    return with<U>(
+        impl::MapStage<Stage, std::decay_t<F>>{stage_, std::forward<F>(f)});
   }
+
+  template <typename F> auto map(F &&f) && {
+    using U = std::decay_t<std::invoke_result_t<F &, T>>;
+    return std::move(*this).template with<U>(
+        impl::MapStage<Stage, std::decay_t<F>>{std::move(stage_),
+                                               std::forward<F>(f)});
+  }
+
+  template <typename Pred> auto filter(Pred &&pred) const & {
+    return with<T>(impl::FilterStage<Stage, std::decay_t<Pred>>{
+        stage_, std::forward<Pred>(pred)});
+  }
+
+  template <typename Pred> auto filter(Pred &&pred) && {
+    return std::move(*this).template with<T>(
+        impl::FilterStage<Stage, std::decay_t<Pred>>{
+            std::move(stage_), std::forward<Pred>(pred)});
+  }
+
+  // Calls func on every element the comprehension generates, in order.
+  template <typename Func> void forEach(Func &&func) const {
+    for (const auto &item : source_)
+      stage_(item, func);
+  }
+
+  List<T, Storage> toList() const {
+    typename Storage::template Builder<T> result;
+    forEach([&result](auto &&item) {
+      result.push_back(std::forward<decltype(item)>(item));
+    });
+    return List<T, Storage>(std::move(result).finish());
+  }
+
+  operator List<T, Storage>() const { return toList(); }
 };
 
+// A List whose deque allocates from the current ArenaScope, e.g. for
+// intermediates of a computation that runs inside one.
+template <typename T> using ArenaList = List<T, ArenaStorage>;
+
+// The default List under a one-parameter name, for the typeclasses and
+// other template template parameters.
+template <typename T> using DequeList = List<T>;
+
+// A List of shared cons cells, e.g. for recursion over tail().
+template <typename T> using ConsList = List<T, ConsStorage>;
+
+// A List with O(log n) concatenation, e.g. for logs built by appending.
+template <typename T> using FingerList = List<T, FingerStorage>;
+
+// A List holding up to N elements without allocating, e.g. for the results
+// of a generator that yields zero or one value per input.
+template <typename T, std::size_t N = 2>
+using SmallList = List<T, SmallStorage<N>>;
+
 // Writer Monad
 template <typename T, typename W = std::string> class Writer {
 private:
@@ -149,71 +338,105 @@ public:
 
   Writer(T val, W l) : value(std::move(val)), log(std::move(l)) {}
 
-  std::pair<T, W> run() const { return {value, log}; }
+  std::pair<T, W> run() const & { return {value, log}; }
+  std::pair<T, W> run() && { return {std::move(value), std::move(log)}; }
+
+  // The parts of run(), without copying them.
+  const T &getValue() const { return value; }
+  const W &getLog() const { return log; }
 
-  template <typename F> auto map(F &&f) const {
+  template <typename F> auto map(F &&f) const & {
     return Writer<std::invoke_result_t<F, T>, W>(std::forward<F>(f)(value),
                                                  log);
   }
 
-  template <typename F> auto and_then(F &&f) const {
+  template <typename F> auto map(F &&f) && {
+    return Writer<std::invoke_result_t<F, T>, W>(
+        std::forward<F>(f)(std::move(value)), std::move(log));
+  }
+
+  template <typename F> auto and_then(F &&f) const & {
     auto [new_value, new_log] = std::forward<F>(f)(value).run();
     return Writer<decltype(new_value), W>(
         std::move(new_value),
-        log + new_log // Assumes W supports operator+
+        log + std::move(new_log) // Assumes W supports operator+
     );
   }
-};
 
-template <> struct Show<int> {
-  static std::string show(const int &x) { return std::to_string(x); }
+  // Moves the value into f and appends to this log in place, where W's
+  // operator+ reuses an rvalue left operand, as std::string's does.
+  template <typename F> auto and_then(F &&f) && {
+    auto [new_value, new_log]
+        = std::forward<F>(f)(std::move(value)).run();
+    return Writer<decltype(new_value), W>(std::move(new_value),
+                                          std::move(log) + std::move(new_log));
+  }
 };
 
-template <> struct Show<long> {
-  static std::string show(const long &x) { return std::to_string(x); }
-};
+template <typename T, typename Storage> struct Show<List<T, Storage>> {
+  template <typename Out>
+  static void showTo(const List<T, Storage> &xs, Out &out) {
+    impl::write(out, '[');
+    bool first = true;
+    for (const auto &x : xs) {
+      if (!first)
+        impl::write(out, ", ");
+      first = false;
+      impl::showInto(x, out);
+    }
+    impl::write(out, ']');
+  }
 
-template <> struct Show<long long> {
-  static std::string show(const long long &x) { return std::to_string(x); }
-};
+  // Only counted when the elements can be, which costs one extra pass.
+  template <bool Sized = impl::HasMember_shownSize<T>::value,
+            typename = std::enable_if_t<Sized>>
+  static std::size_t shownSize(const List<T, Storage> &xs) {
+    std::size_t size = xs.null() ? 2 : 2 * xs.length();
+    for (const auto &x : xs)
+      size += impl::shownSize(x);
+    return size;
+  }
 
-template <> struct Show<unsigned int> {
-  static std::string show(const unsigned int &x) { return std::to_string(x); }
+  static std::string show(const List<T, Storage> &xs) {
+    return impl::showString(xs);
+  }
 };
 
-template <> struct Show<unsigned long> {
-  static std::string show(const unsigned long &x) { return std::to_string(x); }
-};
+template <typename T> struct Show<Identity<T>> {
+  template <typename Out> static void showTo(const Identity<T> &x, Out &out) {
+    impl::write(out, "Identity(");
+    impl::showInto(*x, out);
+    impl::write(out, ')');
+  }
 
-template <> struct Show<unsigned long long> {
-  static std::string show(const unsigned long long &x) {
-    return std::to_string(x);
+  template <bool Sized = impl::HasMember_shownSize<T>::value,
+            typename = std::enable_if_t<Sized>>
+  static std::size_t shownSize(const Identity<T> &x) {
+    return impl::shownSize(*x) + 10;
   }
-};
 
-template <> struct Show<float> {
-  static std::string show(const float &x) { return std::to_string(x); }
+  static std::string show(const Identity<T> &x) {
+    return impl::showString(x);
+  }
 };
 
-template <> struct Show<double> {
-  static std::string show(const double &x) { return std::to_string(x); }
-};
+template <typename T, typename W> struct Show<Writer<T, W>> {
+  template <typename Out> static void showTo(const Writer<T, W> &x, Out &out) {
+    impl::write(out, "Writer(");
+    impl::showInto(x.getValue(), out);
+    impl::write(out, ", ");
+    impl::showInto(x.getLog(), out);
+    impl::write(out, ')');
+  }
 
-template <> struct Show<std::string> {
-  static std::string show(const std::string &x) { return "\"" + x + "\""; }
-};
+  template <bool Sized = impl::AllSized<T, W>,
+            typename = std::enable_if_t<Sized>>
+  static std::size_t shownSize(const Writer<T, W> &x) {
+    return impl::shownSize(x.getValue()) + impl::shownSize(x.getLog()) + 10;
+  }
 
-template <typename T> struct Show<List<T>> {
-  static std::string show(const List<T> &xs) {
-    std::string result = "[";
-    for (const auto &x : xs) {
-      result += Show<T>::show(x) + ", ";
-    }
-    if (!xs.null()) {
-      result.pop_back();
-      result.pop_back();
-    }
-    return result + "]";
+  static std::string show(const Writer<T, W> &x) {
+    return impl::showString(x);
   }
 };
 
@@ -223,7 +446,7 @@ template <typename T> struct Show<List<T>> {
 template <> struct Functor<Identity> {
   template <typename A, typename B>
   static Identity<B> fmap(Identity<A> fa, std::function<B(A)> f) {
-    return fa.map(f);
+    return std::move(fa).map(f);
   }
 };
 
@@ -240,32 +463,7 @@ template <> struct Monad<Identity> {
 
   template <typename A, typename B>
   static Identity<B> bind(Identity<A> ma, std::function<Identity<B>(A)> f) {
-    return ma.and_then(f);
-  }
-};
-
-// List Monad
-template <> struct Functor<List> {
-  template <typename A, typename B>
-  static List<B> fmap(List<A> fa, std::function<B(A)> f) {
-    return fa.map(f);
-  }
-};
-
-template <> struct Applicative<List> {
-  template <typename A> static List<A> pure(A a) {
-    return List<A>(std::move(a));
-  }
-};
-
-template <> struct Monad<List> {
-  template <typename A> static List<A> return_(A a) {
-    return List<A>(std::move(a));
-  }
-
-  template <typename A, typename B>
-  static List<B> bind(List<A> ma, std::function<List<B>(A)> f) {
-    return ma.and_then(f);
+    return std::move(ma).and_then(f);
   }
 };
 
@@ -274,8 +472,9 @@ template <typename T> Identity<T> return_identity(T value) {
   return Identity<T>(std::move(value));
 }
 
-template <typename T> List<T> return_list(T value) {
-  return List<T>(std::move(value));
+template <typename T, typename Storage = DequeStorage>
+List<T, Storage> return_list(T value) {
+  return List<T, Storage>(std::move(value));
 }
 
 template <typename T, typename W>
@@ -288,17 +487,19 @@ template <typename T, typename W> Writer<T, W> tell(W log) {
 }
 
 // from :: List a -> (a -> List b) -> List b
-template <typename T, typename F> auto from(const List<T> &xs, F &&f) {
+template <typename T, typename Storage, typename F>
+auto from(const List<T, Storage> &xs, F &&f) {
   return xs.from(std::forward<F>(f));
 }
 
 // range :: Int -> Int -> List Int
-template <typename T> List<T> range(T start, T end) {
-  std::deque<T> values;
+template <typename T, typename Storage = DequeStorage>
+List<T, Storage> range(T start, T end) {
+  typename Storage::template Builder<T> values;
   for (T i = start; i <= end; ++i) {
     values.push_back(i);
   }
-  return List<T>(std::move(values));
+  return List<T, Storage>(std::move(values).finish());
 }
 
 } // namespace caskell
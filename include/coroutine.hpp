@@ -0,0 +1,221 @@
+#pragma once
+#ifndef CASKELL_COROUTINE_HPP
+#define CASKELL_COROUTINE_HPP
+
+// Coroutine-backed LazyStream sources. Available when compiling as C++20
+// with coroutine support (configure with CASKELL_ENABLE_COROUTINES=ON).
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "lazystream.hpp"
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace caskell {
+namespace impl {
+
+// Per-thread free lists of coroutine frames, bucketed by size. Frames
+// released by a finished coroutine are handed to the next coroutine of a
+// similar size instead of going back to the global allocator.
+class FramePool {
+  static constexpr std::size_t Granularity = 64;
+  static constexpr std::size_t Classes = 64; // frames up to 4 KiB are pooled
+  static constexpr std::size_t MaxCachedPerClass = 256;
+
+  struct FreeFrame {
+    FreeFrame *next;
+  };
+
+  std::array<FreeFrame *, Classes> free_{};
+  std::array<std::size_t, Classes> cached_{};
+
+  static std::size_t classOf(std::size_t size) {
+    return (size + Granularity - 1) / Granularity - 1;
+  }
+
+public:
+  FramePool() = default;
+  FramePool(const FramePool &) = delete;
+  FramePool &operator=(const FramePool &) = delete;
+
+  ~FramePool() {
+    for (auto *head : free_) {
+      while (head) {
+        auto *next = head->next;
+        ::operator delete(head);
+        head = next;
+      }
+    }
+  }
+
+  static FramePool &local() {
+    thread_local FramePool pool;
+    return pool;
+  }
+
+  void *allocate(std::size_t size) {
+    std::size_t c = classOf(size);
+    if (c >= Classes)
+      return ::operator new(size);
+    if (auto *frame = free_[c]) {
+      free_[c] = frame->next;
+      --cached_[c];
+      return frame;
+    }
+    return ::operator new((c + 1) * Granularity);
+  }
+
+  void deallocate(void *p, std::size_t size) {
+    std::size_t c = classOf(size);
+    if (c >= Classes || cached_[c] == MaxCachedPerClass) {
+      ::operator delete(p);
+      return;
+    }
+    free_[c] = new (p) FreeFrame{free_[c]};
+    ++cached_[c];
+  }
+
+  // Number of frames currently cached for reuse.
+  std::size_t cached() const {
+    std::size_t total = 0;
+    for (auto n : cached_)
+      total += n;
+    return total;
+  }
+};
+
+} // namespace impl
+
+// Return type of a co_yield-based coroutine producing T. The coroutine
+// starts suspended and runs to its next co_yield on every next().
+template <typename T> class Coroutine {
+public:
+  struct promise_type {
+    const T *current = nullptr;
+    std::exception_ptr error;
+
+    Coroutine get_return_object() {
+      return Coroutine(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    // The yielded object outlives the suspension, so it is referenced,
+    // not copied.
+    std::suspend_always yield_value(const T &value) noexcept {
+      current = &value;
+      return {};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() { error = std::current_exception(); }
+
+    static void *operator new(std::size_t size) {
+      return impl::FramePool::local().allocate(size);
+    }
+    static void operator delete(void *p, std::size_t size) {
+      impl::FramePool::local().deallocate(p, size);
+    }
+  };
+
+  Coroutine(Coroutine &&other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr)) {}
+  Coroutine &operator=(Coroutine &&other) noexcept {
+    if (this != &other) {
+      reset();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+  ~Coroutine() { reset(); }
+
+  // Resumes the coroutine and returns the next yielded value, or nullptr
+  // once it has finished. Exceptions escaping the body are rethrown here.
+  const T *resume() {
+    if (!handle_ || handle_.done())
+      return nullptr;
+    handle_.resume();
+    if (handle_.done()) {
+      if (auto error = std::exchange(handle_.promise().error, nullptr))
+        std::rethrow_exception(error);
+      return nullptr;
+    }
+    return handle_.promise().current;
+  }
+
+private:
+  explicit Coroutine(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  void reset() {
+    if (handle_)
+      handle_.destroy();
+    handle_ = nullptr;
+  }
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T> class CoroutineGenerator;
+
+namespace impl {
+template <typename T> struct GeneratorTraits<CoroutineGenerator<T>> {
+  using ValueType = T;
+};
+} // namespace impl
+
+// LazyStream source backed by a coroutine. It stores a factory returning
+// Coroutine<T> and starts it on first use; copies hold the factory only,
+// so every terminal operation on a LazyStream replays the sequence from
+// the start, like the other generators do.
+template <typename T>
+class CoroutineGenerator : public Generator<CoroutineGenerator<T>> {
+  std::function<Coroutine<T>()> factory_;
+  mutable std::optional<Coroutine<T>> coroutine_;
+
+  Coroutine<T> &started() const {
+    if (!coroutine_)
+      coroutine_.emplace(factory_());
+    return *coroutine_;
+  }
+
+public:
+  using ValueType = T;
+
+  template <typename F,
+            typename = std::enable_if_t<!std::is_same_v<
+                std::decay_t<F>, CoroutineGenerator>>>
+  explicit CoroutineGenerator(F &&factory)
+      : factory_(std::forward<F>(factory)) {}
+
+  CoroutineGenerator(const CoroutineGenerator &other)
+      : factory_(other.factory_) {}
+  CoroutineGenerator(CoroutineGenerator &&) = default;
+
+  std::optional<T> nextImpl() const {
+    if (const T *value = started().resume())
+      return *value;
+    return std::nullopt;
+  }
+
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    auto &coroutine = started();
+    while (const T *value = coroutine.resume()) {
+      if (!sink(*value))
+        return false;
+    }
+    return true;
+  }
+};
+
+} // namespace caskell
+
+#endif // __cpp_impl_coroutine
+
+#endif // CASKELL_COROUTINE_HPP
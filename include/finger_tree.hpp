@@ -0,0 +1,536 @@
+#pragma once
+#ifndef CASKELL_FINGER_TREE_HPP
+#define CASKELL_FINGER_TREE_HPP
+
+#include "arena.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace caskell {
+namespace impl {
+
+// A persistent sequence stored as a 2-3 finger tree annotated with sizes,
+// after Hinze and Paterson. Adding or removing an element at either end
+// takes amortized O(1); concatenation, splitting and indexing take
+// O(log n). Versions share every subtree they have in common, so copies
+// are O(1). Elements cannot be modified through iterators.
+template <typename T> class FingerTree {
+  // The nodes of every level have one representation. A leaf holds an
+  // element; a branch holds two or three nodes of the level below, so a
+  // branch has a size of at least 2 and a size of 1 identifies a leaf.
+  struct Node {
+    std::size_t size;
+  };
+
+  using NodePtr = std::shared_ptr<const Node>;
+
+  struct Leaf : Node {
+    T value;
+
+    template <typename U>
+    explicit Leaf(U &&x) : Node{1}, value(std::forward<U>(x)) {}
+  };
+
+  struct Branch : Node {
+    unsigned char arity;
+    NodePtr children[3];
+
+    Branch(NodePtr a, NodePtr b)
+        : Node{a->size + b->size}, arity(2),
+          children{std::move(a), std::move(b), nullptr} {}
+    Branch(NodePtr a, NodePtr b, NodePtr c)
+        : Node{a->size + b->size + c->size}, arity(3),
+          children{std::move(a), std::move(b), std::move(c)} {}
+  };
+
+  // One to four nodes at an end of a tree level.
+  struct Digit {
+    NodePtr nodes[4];
+    unsigned char count = 0;
+
+    std::size_t size() const {
+      std::size_t total = 0;
+      for (unsigned i = 0; i < count; ++i)
+        total += nodes[i]->size;
+      return total;
+    }
+
+    const NodePtr &last() const { return nodes[count - 1]; }
+  };
+
+  struct Tree;
+  using TreePtr = std::shared_ptr<const Tree>;
+
+  // A level: a prefix, a deeper tree of branches and a suffix. A tree of
+  // one node keeps it as the prefix and has an empty suffix; the empty
+  // tree is nullptr.
+  struct Tree {
+    std::size_t size;
+    Digit prefix;
+    TreePtr middle;
+    Digit suffix;
+
+    Tree(const Digit &pr, TreePtr m, const Digit &sf)
+        : size(pr.size() + (m ? m->size : 0) + sf.size()), prefix(pr),
+          middle(std::move(m)), suffix(sf) {}
+
+    bool single() const { return suffix.count == 0; }
+  };
+
+  // Up to the 4 + 4 + 4 nodes that concatenation carries between levels.
+  struct Nodes {
+    NodePtr items[12];
+    unsigned count = 0;
+
+    void push(const NodePtr &node) { items[count++] = node; }
+  };
+
+  struct DigitSplit {
+    Digit left;
+    NodePtr node;
+    std::size_t offset;
+    Digit right;
+  };
+
+  struct Split {
+    TreePtr left;
+    NodePtr node;
+    std::size_t offset;
+    TreePtr right;
+  };
+
+  TreePtr root_;
+
+  explicit FingerTree(TreePtr root) : root_(std::move(root)) {}
+
+  template <typename N, typename... Args>
+  static NodePtr makeNode(Args &&...args) {
+    return std::allocate_shared<N>(ArenaAllocator<N>(),
+                                   std::forward<Args>(args)...);
+  }
+
+  static TreePtr makeTree(const Digit &pr, TreePtr m, const Digit &sf) {
+    return std::allocate_shared<Tree>(ArenaAllocator<Tree>(), pr, std::move(m),
+                                      sf);
+  }
+
+  static const T &valueOf(const NodePtr &node) {
+    return static_cast<const Leaf *>(node.get())->value;
+  }
+
+  static Digit digitOf(std::initializer_list<NodePtr> nodes) {
+    Digit digit;
+    for (const NodePtr &node : nodes)
+      digit.nodes[digit.count++] = node;
+    return digit;
+  }
+
+  static Digit childrenOf(const NodePtr &node) {
+    auto *branch = static_cast<const Branch *>(node.get());
+    Digit digit;
+    for (unsigned i = 0; i < branch->arity; ++i)
+      digit.nodes[digit.count++] = branch->children[i];
+    return digit;
+  }
+
+  static Digit dropFront(const Digit &digit) {
+    Digit rest;
+    for (unsigned i = 1; i < digit.count; ++i)
+      rest.nodes[rest.count++] = digit.nodes[i];
+    return rest;
+  }
+
+  static Digit dropBack(Digit digit) {
+    digit.nodes[--digit.count] = nullptr;
+    return digit;
+  }
+
+  static TreePtr single(const NodePtr &node) {
+    return makeTree(digitOf({node}), nullptr, Digit());
+  }
+
+  static TreePtr digitToTree(const Digit &digit) {
+    TreePtr tree;
+    for (unsigned i = 0; i < digit.count; ++i)
+      tree = pushBack(tree, digit.nodes[i]);
+    return tree;
+  }
+
+  static TreePtr pushFront(const TreePtr &tree, const NodePtr &node) {
+    if (!tree)
+      return single(node);
+    if (tree->single())
+      return makeTree(digitOf({node}), nullptr, tree->prefix);
+    const Digit &pr = tree->prefix;
+    if (pr.count < 4) {
+      Digit digit = digitOf({node});
+      for (unsigned i = 0; i < pr.count; ++i)
+        digit.nodes[digit.count++] = pr.nodes[i];
+      return makeTree(digit, tree->middle, tree->suffix);
+    }
+    return makeTree(
+        digitOf({node, pr.nodes[0]}),
+        pushFront(tree->middle,
+                  makeNode<Branch>(pr.nodes[1], pr.nodes[2], pr.nodes[3])),
+        tree->suffix);
+  }
+
+  static TreePtr pushBack(const TreePtr &tree, const NodePtr &node) {
+    if (!tree)
+      return single(node);
+    if (tree->single())
+      return makeTree(tree->prefix, nullptr, digitOf({node}));
+    const Digit &sf = tree->suffix;
+    if (sf.count < 4) {
+      Digit digit = sf;
+      digit.nodes[digit.count++] = node;
+      return makeTree(tree->prefix, tree->middle, digit);
+    }
+    return makeTree(
+        tree->prefix,
+        pushBack(tree->middle,
+                 makeNode<Branch>(sf.nodes[0], sf.nodes[1], sf.nodes[2])),
+        digitOf({sf.nodes[3], node}));
+  }
+
+  // A tree from a possibly empty prefix, borrowing the first branch of the
+  // middle when it is empty.
+  static TreePtr deepFront(const Digit &pr, const TreePtr &m, const Digit &sf) {
+    if (pr.count > 0)
+      return makeTree(pr, m, sf);
+    if (!m)
+      return digitToTree(sf);
+    auto [first, rest] = viewFront(m);
+    return makeTree(childrenOf(first), rest, sf);
+  }
+
+  static TreePtr deepBack(const Digit &pr, const TreePtr &m, const Digit &sf) {
+    if (sf.count > 0)
+      return makeTree(pr, m, sf);
+    if (!m)
+      return digitToTree(pr);
+    auto [rest, last] = viewBack(m);
+    return makeTree(pr, rest, childrenOf(last));
+  }
+
+  static std::pair<NodePtr, TreePtr> viewFront(const TreePtr &tree) {
+    if (tree->single())
+      return {tree->prefix.nodes[0], nullptr};
+    return {tree->prefix.nodes[0],
+            deepFront(dropFront(tree->prefix), tree->middle, tree->suffix)};
+  }
+
+  static std::pair<TreePtr, NodePtr> viewBack(const TreePtr &tree) {
+    if (tree->single())
+      return {nullptr, tree->prefix.nodes[0]};
+    return {deepBack(tree->prefix, tree->middle, dropBack(tree->suffix)),
+            tree->suffix.last()};
+  }
+
+  // Groups two to twelve nodes into branches of two or three.
+  static Nodes branches(const Nodes &nodes) {
+    Nodes result;
+    const NodePtr *n = nodes.items;
+    unsigned left = nodes.count;
+    for (; left > 4; left -= 3, n += 3)
+      result.push(makeNode<Branch>(n[0], n[1], n[2]));
+    if (left == 4) {
+      result.push(makeNode<Branch>(n[0], n[1]));
+      result.push(makeNode<Branch>(n[2], n[3]));
+    } else if (left == 3) {
+      result.push(makeNode<Branch>(n[0], n[1], n[2]));
+    } else {
+      result.push(makeNode<Branch>(n[0], n[1]));
+    }
+    return result;
+  }
+
+  // a, then the nodes, then b.
+  static TreePtr append(const TreePtr &a, const Nodes &nodes,
+                        const TreePtr &b) {
+    if (!a) {
+      TreePtr tree = b;
+      for (unsigned i = nodes.count; i-- > 0;)
+        tree = pushFront(tree, nodes.items[i]);
+      return tree;
+    }
+    if (!b) {
+      TreePtr tree = a;
+      for (unsigned i = 0; i < nodes.count; ++i)
+        tree = pushBack(tree, nodes.items[i]);
+      return tree;
+    }
+    if (a->single())
+      return pushFront(append(nullptr, nodes, b), a->prefix.nodes[0]);
+    if (b->single())
+      return pushBack(append(a, nodes, nullptr), b->prefix.nodes[0]);
+    Nodes between;
+    for (unsigned i = 0; i < a->suffix.count; ++i)
+      between.push(a->suffix.nodes[i]);
+    for (unsigned i = 0; i < nodes.count; ++i)
+      between.push(nodes.items[i]);
+    for (unsigned i = 0; i < b->prefix.count; ++i)
+      between.push(b->prefix.nodes[i]);
+    return makeTree(a->prefix, append(a->middle, branches(between), b->middle),
+                    b->suffix);
+  }
+
+  // The node of a digit holding position i, the position within it, and
+  // the nodes on either side.
+  static DigitSplit splitDigit(const Digit &digit, std::size_t i) {
+    DigitSplit split;
+    unsigned k = 0;
+    for (; i >= digit.nodes[k]->size; ++k) {
+      i -= digit.nodes[k]->size;
+      split.left.nodes[split.left.count++] = digit.nodes[k];
+    }
+    split.node = digit.nodes[k];
+    split.offset = i;
+    for (++k; k < digit.count; ++k)
+      split.right.nodes[split.right.count++] = digit.nodes[k];
+    return split;
+  }
+
+  // The node of a level holding position i < tree->size, the position
+  // within it, and the trees of the nodes before and after it.
+  static Split splitTree(const TreePtr &tree, std::size_t i) {
+    if (tree->single())
+      return {nullptr, tree->prefix.nodes[0], i, nullptr};
+    std::size_t prefixSize = tree->prefix.size();
+    if (i < prefixSize) {
+      DigitSplit s = splitDigit(tree->prefix, i);
+      return {digitToTree(s.left), s.node, s.offset,
+              deepFront(s.right, tree->middle, tree->suffix)};
+    }
+    i -= prefixSize;
+    std::size_t middleSize = tree->middle ? tree->middle->size : 0;
+    if (i < middleSize) {
+      Split m = splitTree(tree->middle, i);
+      DigitSplit s = splitDigit(childrenOf(m.node), m.offset);
+      return {deepBack(tree->prefix, m.left, s.left), s.node, s.offset,
+              deepFront(s.right, m.right, tree->suffix)};
+    }
+    DigitSplit s = splitDigit(tree->suffix, i - middleSize);
+    return {deepBack(tree->prefix, tree->middle, s.left), s.node, s.offset,
+            digitToTree(s.right)};
+  }
+
+  // The node of a level holding position i, and the position within it.
+  static std::pair<const NodePtr *, std::size_t> lookup(const Tree &tree,
+                                                        std::size_t i) {
+    for (unsigned k = 0; k < tree.prefix.count; ++k) {
+      if (i < tree.prefix.nodes[k]->size)
+        return {&tree.prefix.nodes[k], i};
+      i -= tree.prefix.nodes[k]->size;
+    }
+    if (tree.middle) {
+      if (i < tree.middle->size) {
+        auto [node, j] = lookup(*tree.middle, i);
+        auto *branch = static_cast<const Branch *>(node->get());
+        unsigned k = 0;
+        for (; j >= branch->children[k]->size; ++k)
+          j -= branch->children[k]->size;
+        return {&branch->children[k], j};
+      }
+      i -= tree.middle->size;
+    }
+    unsigned k = 0;
+    for (; i >= tree.suffix.nodes[k]->size; ++k)
+      i -= tree.suffix.nodes[k]->size;
+    return {&tree.suffix.nodes[k], i};
+  }
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using reference = const T &;
+  using const_reference = const T &;
+
+  // Walks the tree in order with an explicit stack, so a full pass is O(n).
+  class const_iterator {
+    // Either a tree level, at the position of its next part (prefix nodes,
+    // middle, suffix nodes), or a node, at its next child.
+    struct Frame {
+      const Tree *tree;
+      const Node *node;
+      unsigned next;
+    };
+
+    ArenaVector<Frame> stack_;
+    std::size_t index_ = 0;
+
+    void pushNode(const NodePtr &node) {
+      stack_.push_back(Frame{nullptr, node.get(), 0});
+    }
+
+    // Descends to the next leaf, or empties the stack at the end.
+    void settle() {
+      while (!stack_.empty()) {
+        Frame &top = stack_.back();
+        if (top.node) {
+          if (top.node->size == 1)
+            return;
+          auto *branch = static_cast<const Branch *>(top.node);
+          if (top.next < branch->arity)
+            pushNode(branch->children[top.next++]);
+          else
+            stack_.pop_back();
+          continue;
+        }
+        const Tree *tree = top.tree;
+        unsigned part = top.next++;
+        unsigned prefixCount = tree->prefix.count;
+        if (part < prefixCount) {
+          pushNode(tree->prefix.nodes[part]);
+        } else if (part == prefixCount) {
+          if (tree->middle)
+            stack_.push_back(Frame{tree->middle.get(), nullptr, 0});
+        } else if (part <= prefixCount + tree->suffix.count) {
+          pushNode(tree->suffix.nodes[part - prefixCount - 1]);
+        } else {
+          stack_.pop_back();
+        }
+      }
+    }
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T *;
+    using reference = const T &;
+
+    const_iterator() = default;
+
+    const_iterator(const Tree *root, std::size_t index) : index_(index) {
+      if (root) {
+        stack_.push_back(Frame{root, nullptr, 0});
+        settle();
+      }
+    }
+
+    reference operator*() const {
+      return static_cast<const Leaf *>(stack_.back().node)->value;
+    }
+    pointer operator->() const { return &**this; }
+
+    const_iterator &operator++() {
+      stack_.pop_back();
+      ++index_;
+      settle();
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator it = *this;
+      ++*this;
+      return it;
+    }
+
+    friend bool operator==(const const_iterator &lhs,
+                           const const_iterator &rhs) {
+      return lhs.index_ == rhs.index_;
+    }
+    friend bool operator!=(const const_iterator &lhs,
+                           const const_iterator &rhs) {
+      return lhs.index_ != rhs.index_;
+    }
+  };
+
+  using iterator = const_iterator;
+
+  class Builder {
+    TreePtr root_;
+
+  public:
+    template <typename U> void push_back(U &&x) {
+      root_ = pushBack(root_, makeNode<Leaf>(std::forward<U>(x)));
+    }
+
+    template <typename It> void append(It first, It last) {
+      for (; first != last; ++first)
+        push_back(*first);
+    }
+
+    FingerTree finish() && { return FingerTree(std::move(root_)); }
+  };
+
+  FingerTree() = default;
+
+  template <typename It, typename = typename std::iterator_traits<
+                             It>::iterator_category>
+  FingerTree(It first, It last) {
+    Builder builder;
+    builder.append(first, last);
+    *this = std::move(builder).finish();
+  }
+
+  FingerTree(std::initializer_list<T> init)
+      : FingerTree(init.begin(), init.end()) {}
+
+  std::size_t size() const { return root_ ? root_->size : 0; }
+  bool empty() const { return !root_; }
+
+  const T &front() const { return valueOf(root_->prefix.nodes[0]); }
+
+  const T &back() const {
+    return valueOf(root_->single() ? root_->prefix.nodes[0]
+                                   : root_->suffix.last());
+  }
+
+  const T &operator[](std::size_t i) const {
+    return valueOf(*lookup(*root_, i).first);
+  }
+
+  const_iterator begin() const { return const_iterator(root_.get(), 0); }
+  const_iterator end() const { return const_iterator(nullptr, size()); }
+
+  void push_front(T x) {
+    root_ = pushFront(root_, makeNode<Leaf>(std::move(x)));
+  }
+
+  void push_back(T x) {
+    root_ = pushBack(root_, makeNode<Leaf>(std::move(x)));
+  }
+
+  FingerTree tail() const {
+    return empty() ? FingerTree() : FingerTree(viewFront(root_).second);
+  }
+
+  FingerTree init() const {
+    return empty() ? FingerTree() : FingerTree(viewBack(root_).first);
+  }
+
+  static FingerTree concat(const FingerTree &xs, const FingerTree &ys) {
+    return FingerTree(append(xs.root_, Nodes(), ys.root_));
+  }
+
+  // The first n elements and the rest.
+  std::pair<FingerTree, FingerTree> splitAt(std::size_t n) const {
+    if (n == 0)
+      return {FingerTree(), *this};
+    if (n >= size())
+      return {*this, FingerTree()};
+    Split split = splitTree(root_, n);
+    return {FingerTree(split.left),
+            FingerTree(pushFront(split.right, split.node))};
+  }
+
+  friend bool operator==(const FingerTree &lhs, const FingerTree &rhs) {
+    return lhs.root_ == rhs.root_
+           || (lhs.size() == rhs.size()
+               && std::equal(lhs.begin(), lhs.end(), rhs.begin()));
+  }
+
+  friend bool operator!=(const FingerTree &lhs, const FingerTree &rhs) {
+    return !(lhs == rhs);
+  }
+};
+
+} // namespace impl
+} // namespace caskell
+
+#endif // CASKELL_FINGER_TREE_HPP
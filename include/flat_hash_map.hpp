@@ -0,0 +1,161 @@
+#pragma once
+#ifndef CASKELL_FLAT_HASH_MAP_HPP
+#define CASKELL_FLAT_HASH_MAP_HPP
+
+#include "arena.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace caskell {
+namespace impl {
+
+// Insertion-ordered hash map with open addressing. Entries live densely in
+// a vector in the order they were first inserted; the probe table holds
+// only 8-byte buckets (a hash tag and an entry index), so lookups touch
+// one or two cache lines and iteration is a plain vector walk. Collisions
+// are resolved by linear probing at a load factor of at most 3/4. Entries
+// cannot be erased, and pointers returned by find() and tryEmplace() are
+// invalidated by the next insertion. The probe table is scratch and comes
+// from the current ArenaScope, if any.
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>>
+class FlatHashMap {
+public:
+  using value_type = std::pair<Key, Value>;
+  using iterator = typename std::vector<value_type>::iterator;
+  using const_iterator = typename std::vector<value_type>::const_iterator;
+
+  FlatHashMap() = default;
+  explicit FlatHashMap(std::size_t expected) { reserve(expected); }
+
+  // Sizes the table so that expected entries fit without rehashing.
+  void reserve(std::size_t expected) {
+    entries_.reserve(expected);
+    std::size_t wanted = bucketsFor(expected);
+    if (wanted > buckets_.size())
+      rehash(wanted);
+  }
+
+  std::size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+
+  Value *find(const Key &key) {
+    return const_cast<Value *>(std::as_const(*this).find(key));
+  }
+
+  const Value *find(const Key &key) const {
+    if (buckets_.empty())
+      return nullptr;
+    std::size_t hash = mix(hash_(key));
+    for (std::size_t i = hash & mask();; i = (i + 1) & mask()) {
+      const Bucket &bucket = buckets_[i];
+      if (bucket.index == Empty)
+        return nullptr;
+      if (matches(bucket, hash, key))
+        return &entries_[bucket.index].second;
+    }
+  }
+
+  // Inserts (key, Value(args...)) unless key is present. Returns the
+  // mapped value and whether it was inserted.
+  template <typename K, typename... Args>
+  std::pair<Value *, bool> tryEmplace(K &&key, Args &&...args) {
+    if (entries_.size() + 1 > buckets_.size() / 4 * 3)
+      rehash(std::max<std::size_t>(16, buckets_.size() * 2));
+    std::size_t hash = mix(hash_(key));
+    std::size_t i = hash & mask();
+    for (;; i = (i + 1) & mask()) {
+      const Bucket &bucket = buckets_[i];
+      if (bucket.index == Empty)
+        break;
+      if (matches(bucket, hash, key))
+        return {&entries_[bucket.index].second, false};
+    }
+    assert(entries_.size() < Empty && "FlatHashMap is limited to 2^32-1");
+    buckets_[i] = {tagOf(hash), static_cast<std::uint32_t>(entries_.size())};
+    entries_.emplace_back(std::piecewise_construct,
+                          std::forward_as_tuple(std::forward<K>(key)),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+    return {&entries_.back().second, true};
+  }
+
+  Value &operator[](const Key &key) { return *tryEmplace(key).first; }
+
+  // Gives up the entries, in first-insertion order, and empties the map.
+  std::vector<value_type> release() && {
+    buckets_.clear();
+    return std::move(entries_);
+  }
+
+private:
+  struct Bucket {
+    std::uint32_t tag;
+    std::uint32_t index;
+  };
+
+  static constexpr std::uint32_t Empty
+      = std::numeric_limits<std::uint32_t>::max();
+
+  ArenaVector<Bucket> buckets_;
+  std::vector<value_type> entries_;
+  Hash hash_;
+  Equal equal_;
+
+  std::size_t mask() const { return buckets_.size() - 1; }
+
+  // Smallest power of two keeping count entries at or below 3/4 load.
+  static std::size_t bucketsFor(std::size_t count) {
+    std::size_t buckets = 16;
+    while (buckets / 4 * 3 < count)
+      buckets *= 2;
+    return buckets;
+  }
+
+  // std::hash is the identity for integers; spread the bits so that
+  // sequential keys do not cluster under linear probing.
+  static std::size_t mix(std::size_t hash) {
+    std::uint64_t x = hash;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return static_cast<std::size_t>(x);
+  }
+
+  static std::uint32_t tagOf(std::size_t hash) {
+    return static_cast<std::uint32_t>(static_cast<std::uint64_t>(hash) >> 32);
+  }
+
+  template <typename K>
+  bool matches(const Bucket &bucket, std::size_t hash, const K &key) const {
+    return bucket.tag == tagOf(hash)
+           && equal_(entries_[bucket.index].first, key);
+  }
+
+  void rehash(std::size_t count) {
+    buckets_.assign(count, Bucket{0, Empty});
+    for (std::size_t e = 0; e < entries_.size(); ++e) {
+      std::size_t hash = mix(hash_(entries_[e].first));
+      std::size_t i = hash & mask();
+      while (buckets_[i].index != Empty)
+        i = (i + 1) & mask();
+      buckets_[i] = {tagOf(hash), static_cast<std::uint32_t>(e)};
+    }
+  }
+};
+
+} // namespace impl
+} // namespace caskell
+
+#endif // CASKELL_FLAT_HASH_MAP_HPP
@@ -0,0 +1,109 @@
+#pragma once
+#ifndef CASKELL_FUSION_HPP
+#define CASKELL_FUSION_HPP
+
+#include <type_traits>
+#include <utility>
+
+namespace caskell {
+namespace impl {
+
+// Stages of a fused pipeline. A stage receives one source element and hands
+// zero or one results to the downstream sink, so stages compose without
+// materializing anything in between.
+struct IdentityStage {
+  template <typename T, typename Sink>
+  void operator()(T &&item, Sink &&sink) const {
+    sink(std::forward<T>(item));
+  }
+};
+
+template <typename Prev, typename Func> struct MapStage {
+  Prev prev;
+  Func func;
+
+  template <typename T, typename Sink>
+  void operator()(T &&item, Sink &&sink) const {
+    prev(std::forward<T>(item), [&](auto &&value) {
+      sink(func(std::forward<decltype(value)>(value)));
+    });
+  }
+};
+
+template <typename Prev, typename Pred> struct FilterStage {
+  Prev prev;
+  Pred pred;
+
+  template <typename T, typename Sink>
+  void operator()(T &&item, Sink &&sink) const {
+    prev(std::forward<T>(item), [&](auto &&value) {
+      if (pred(value))
+        sink(std::forward<decltype(value)>(value));
+    });
+  }
+};
+
+// Whether a stage may drop elements, so that the source size is only an
+// upper bound of its output.
+template <typename Stage> struct IsSelective : std::true_type {};
+
+template <> struct IsSelective<IdentityStage> : std::false_type {};
+
+template <typename Prev, typename Func>
+struct IsSelective<MapStage<Prev, Func>> : IsSelective<Prev> {};
+
+template <typename T, typename = void>
+struct HasMember_isJust : std::false_type {};
+
+template <typename T>
+struct HasMember_isJust<T, std::void_t<decltype(std::declval<T &>().isJust())>>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct HasMember_forEach : std::false_type {};
+
+template <typename T>
+struct HasMember_forEach<
+    T, std::void_t<decltype(std::declval<T &>().forEach(
+           std::declval<void (*)(const typename T::value_type &)>()))>>
+    : std::true_type {};
+
+// Hands every element of a generator's result to sink: the value of a
+// Maybe if it has one, the output of anything with forEach (such as a
+// pending comprehension or stream), or else the elements of a range,
+// moved out of a temporary.
+template <typename R, typename Sink> void expand(R &&result, Sink &&sink) {
+  using Result = std::remove_reference_t<R>;
+  if constexpr (HasMember_isJust<Result>::value) {
+    if (result.isJust())
+      sink(std::move(*result));
+  } else if constexpr (HasMember_forEach<Result>::value) {
+    result.forEach(sink);
+  } else {
+    for (auto &&item : result) {
+      if constexpr (std::is_lvalue_reference_v<R>) {
+        sink(item);
+      } else {
+        sink(std::move(item));
+      }
+    }
+  }
+}
+
+// Replaces each element by the elements of func(element), as >>= does.
+template <typename Prev, typename Func> struct BindStage {
+  Prev prev;
+  Func func;
+
+  template <typename T, typename Sink>
+  void operator()(T &&item, Sink &&sink) const {
+    prev(std::forward<T>(item), [&](auto &&value) {
+      expand(func(std::forward<decltype(value)>(value)), sink);
+    });
+  }
+};
+
+} // namespace impl
+} // namespace caskell
+
+#endif // CASKELL_FUSION_HPP
@@ -0,0 +1,278 @@
+#pragma once
+#ifndef CASKELL_LAZYLIST_HPP
+#define CASKELL_LAZYLIST_HPP
+
+#include "lazystream.hpp"
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace caskell {
+
+template <typename T> class LazyList;
+
+namespace impl {
+
+// Append-only arena of T. Elements are constructed in fixed-size blocks and
+// never move, so references to forced cells stay valid for the arena's life.
+template <typename T> class CellArena {
+  static constexpr std::size_t BlockSize = 1024;
+
+  struct alignas(T) Slot {
+    unsigned char bytes[sizeof(T)];
+  };
+
+  std::vector<std::unique_ptr<Slot[]>> blocks_;
+  std::size_t size_ = 0;
+
+  T *slot(std::size_t i) const {
+    return std::launder(
+        reinterpret_cast<T *>(blocks_[i / BlockSize][i % BlockSize].bytes));
+  }
+
+public:
+  CellArena() = default;
+  CellArena(const CellArena &) = delete;
+  CellArena &operator=(const CellArena &) = delete;
+
+  ~CellArena() {
+    for (std::size_t i = 0; i < size_; ++i)
+      slot(i)->~T();
+  }
+
+  std::size_t size() const { return size_; }
+  const T &operator[](std::size_t i) const { return *slot(i); }
+
+  template <typename... Args> const T &emplace_back(Args &&...args) {
+    if (size_ == blocks_.size() * BlockSize)
+      blocks_.emplace_back(new Slot[BlockSize]);
+    T *cell = new (slot(size_)) T(std::forward<Args>(args)...);
+    ++size_;
+    return *cell;
+  }
+};
+
+// Shared, memoizing state behind every LazyList that views the same
+// sequence. Cells are forced strictly in order, each exactly once.
+template <typename T>
+class LazyListState : public std::enable_shared_from_this<LazyListState<T>> {
+public:
+  using Producer
+      = std::function<std::optional<T>(const LazyList<T> &, std::size_t)>;
+
+  explicit LazyListState(Producer producer) : producer_(std::move(producer)) {}
+
+  // Returns the cell at index, forcing it and every cell before it, or
+  // nullptr when the sequence ends before index.
+  const T *force(std::size_t index) {
+    if (index < cells_.size())
+      return &cells_[index];
+    if (forcing_)
+      throw std::logic_error("LazyList: element depends on an unforced cell");
+    forcing_ = true;
+    try {
+      LazyList<T> self(this->shared_from_this(), 0);
+      while (!exhausted_ && cells_.size() <= index) {
+        auto value = producer_(self, cells_.size());
+        if (value) {
+          cells_.emplace_back(std::move(*value));
+        } else {
+          exhausted_ = true;
+          producer_ = nullptr;
+        }
+      }
+    } catch (...) {
+      forcing_ = false;
+      throw;
+    }
+    forcing_ = false;
+    return index < cells_.size() ? &cells_[index] : nullptr;
+  }
+
+  std::size_t forced() const { return cells_.size(); }
+
+private:
+  CellArena<T> cells_;
+  Producer producer_;
+  bool exhausted_ = false;
+  bool forcing_ = false;
+};
+
+} // namespace impl
+
+// Memoized, call-by-need list in the style of Haskell's lazy lists.
+// Elements are computed on first access, cached in an arena shared by every
+// copy and tail of the list, and never recomputed. A producer may read
+// earlier elements of the list it is building, which makes self-referential
+// definitions such as fibs or sieves direct. Not thread-safe.
+template <typename T> class LazyList {
+  std::shared_ptr<impl::LazyListState<T>> state_;
+  std::size_t offset_ = 0;
+
+  friend class impl::LazyListState<T>;
+
+  LazyList(std::shared_ptr<impl::LazyListState<T>> state, std::size_t offset)
+      : state_(std::move(state)), offset_(offset) {}
+
+  const T *cell(std::size_t i) const {
+    return state_ ? state_->force(offset_ + i) : nullptr;
+  }
+
+public:
+  using value_type = T;
+
+  LazyList() = default;
+
+  // Memoizes the elements of a LazyStream; the stream's chain runs once,
+  // incrementally, no matter how many consumers walk the list.
+  template <typename Gen>
+  explicit LazyList(const LazyStream<Gen> &stream)
+      : LazyList(std::make_shared<impl::LazyListState<T>>(
+                     [gen = stream.generator()](const LazyList &,
+                                                std::size_t) {
+                       return std::optional<T>(gen.next());
+                     }),
+                 0) {}
+
+  // generate :: (LazyList a -> Int -> a) -> LazyList a
+  // f(self, i) computes element i and may read self[j] for any j < i. An f
+  // returning std::optional<T> ends the list at its first std::nullopt;
+  // otherwise the list is infinite.
+  template <typename F> static LazyList generate(F &&f) {
+    using R = std::invoke_result_t<F &, const LazyList &, std::size_t>;
+    typename impl::LazyListState<T>::Producer producer;
+    if constexpr (std::is_convertible_v<R, std::optional<T>>
+                  && !std::is_convertible_v<R, T>) {
+      producer = std::forward<F>(f);
+    } else {
+      producer = [f = std::forward<F>(f)](const LazyList &self,
+                                          std::size_t i) {
+        return std::optional<T>(f(self, i));
+      };
+    }
+    return LazyList(
+        std::make_shared<impl::LazyListState<T>>(std::move(producer)), 0);
+  }
+
+  // Haskell-style list operations
+  bool null() const { return cell(0) == nullptr; }
+  const T &head() const { return at(0); }
+  LazyList tail() const {
+    if (null())
+      return LazyList();
+    return LazyList(state_, offset_ + 1);
+  }
+
+  const T &operator[](std::size_t i) const { return *cell(i); }
+  const T &at(std::size_t i) const {
+    if (auto c = cell(i))
+      return *c;
+    throw std::out_of_range("LazyList: index past the end of the list");
+  }
+
+  // Number of cells computed so far across all views of this list.
+  std::size_t forced() const { return state_ ? state_->forced() : 0; }
+
+  class Iterator {
+    const LazyList *list_ = nullptr;
+    std::size_t index_ = 0;
+    const T *current_ = nullptr;
+
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T *;
+    using reference = const T &;
+
+    Iterator() = default;
+    explicit Iterator(const LazyList *list)
+        : list_(list), current_(list->cell(0)) {}
+
+    reference operator*() const { return *current_; }
+    pointer operator->() const { return current_; }
+
+    Iterator &operator++() {
+      current_ = list_->cell(++index_);
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    bool operator==(const Iterator &other) const {
+      return current_ == other.current_;
+    }
+    bool operator!=(const Iterator &other) const { return !(*this == other); }
+  };
+
+  Iterator begin() const { return Iterator(this); }
+  Iterator end() const { return Iterator(); }
+
+  // Streams the list's elements, forcing them on demand.
+  auto stream() const;
+};
+
+template <typename T> class LazyListGenerator;
+
+namespace impl {
+template <typename T> struct GeneratorTraits<LazyListGenerator<T>> {
+  using ValueType = T;
+};
+} // namespace impl
+
+// Walks a LazyList as a LazyStream source; copies of the generator share the
+// list's memoized cells.
+template <typename T>
+class LazyListGenerator : public Generator<LazyListGenerator<T>> {
+  mutable LazyList<T> list_;
+
+public:
+  using ValueType = T;
+  explicit LazyListGenerator(LazyList<T> list) : list_(std::move(list)) {}
+  std::optional<T> nextImpl() const {
+    if (list_.null())
+      return std::nullopt;
+    std::optional<T> item = list_.head();
+    list_ = list_.tail();
+    return item;
+  }
+  const T *nextRefImpl() const {
+    if (list_.null())
+      return nullptr;
+    const T *item = &list_.head();
+    list_ = list_.tail();
+    return item;
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    for (; !list_.null(); list_ = list_.tail()) {
+      if (!sink(list_.head())) {
+        list_ = list_.tail();
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+template <typename T> auto LazyList<T>::stream() const {
+  return LazyStream<LazyListGenerator<T>>(LazyListGenerator<T>(*this));
+}
+
+// memoize :: LazyStream a -> LazyList a
+template <typename Gen> auto memoize(const LazyStream<Gen> &stream) {
+  return LazyList<typename Gen::ValueType>(stream);
+}
+
+} // namespace caskell
+
+#endif // CASKELL_LAZYLIST_HPP
@@ -1,31 +1,51 @@
 #ifndef CASKELL_LAZYSTREAM_HPP
 #define CASKELL_LAZYSTREAM_HPP
 
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "sort.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
 #include <optional>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace caskell {
 
 namespace impl {
-template <typename T, typename = void>
-struct HasMember_push_back : std::false_type {};
+template <typename Gen, typename = void>
+struct HasMember_nextRefImpl : std::false_type {};
 
-template <typename T>
-struct HasMember_push_back<T,
-                           std::void_t<decltype(std::declval<T &>().push_back(
-                               std::declval<typename T::value_type>()))>>
+template <typename Gen>
+struct HasMember_nextRefImpl<
+    Gen, std::void_t<decltype(std::declval<const Gen &>().nextRefImpl())>>
     : std::true_type {};
 
-template <typename T, typename = void>
-struct HasMember_insert : std::false_type {};
+template <typename Gen, typename Sink, typename = void>
+struct HasMember_pushImpl : std::false_type {};
 
-template <typename T>
-struct HasMember_insert<T, std::void_t<decltype(std::declval<T &>().insert(
-                               std::declval<typename T::iterator>(),
-                               std::declval<typename T::value_type>()))>>
+template <typename Gen, typename Sink>
+struct HasMember_pushImpl<Gen, Sink,
+                          std::void_t<decltype(std::declval<const Gen &>()
+                                                   .pushImpl(std::declval<
+                                                             Sink &>()))>>
     : std::true_type {};
 
+// Number of elements moved per call of the block-at-a-time protocol.
+inline constexpr std::size_t BatchSize = 256;
+
+// Element types that can be staged in a stack block of BatchSize elements.
+template <typename T>
+inline constexpr bool IsBatchElement = std::is_default_constructible_v<T>
+                                       && std::is_trivially_copyable_v<T>
+                                       && sizeof(T) <= 64;
+
 } // namespace impl
 template <typename T> class RangeGenerator;
 // template <typename Container> class ContainerGenerator;
@@ -35,11 +55,98 @@ class ContainerGenerator;
 template <typename Gen, typename Func> class MapGenerator;
 template <typename Gen, typename Pred> class FilterGenerator;
 template <typename Gen> class TakeGenerator;
+template <typename GenA, typename GenB> class ZipGenerator;
+template <typename Gen> class EnumerateGenerator;
+template <typename Gen, typename Func> class FlatMapGenerator;
+template <typename Gen, typename U, typename Func> class ScanGenerator;
+template <typename Gen, typename Pred> class TakeWhileGenerator;
+template <typename Gen, typename Pred> class DropWhileGenerator;
+template <typename Gen, std::size_t N> class ChunkGenerator;
+template <typename Gen> class LazyStream;
+
+// Up to N consecutive elements produced by LazyStream::chunk<N>(); only the
+// last chunk of a stream may hold fewer than N.
+template <typename T, std::size_t N> struct Chunk {
+  std::array<T, N> items{};
+  std::size_t count = 0;
+
+  std::size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  const T &operator[](std::size_t i) const { return items[i]; }
+  const T *begin() const { return items.data(); }
+  const T *end() const { return items.data() + count; }
+
+  friend bool operator==(const Chunk &lhs, const Chunk &rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+  }
+  friend bool operator!=(const Chunk &lhs, const Chunk &rhs) {
+    return !(lhs == rhs);
+  }
+};
 
 namespace impl {
 template <typename T> struct GeneratorTraits;
+
+// True when every stage of the chain implements nextBatchImpl(). Generators
+// whose traits do not declare IsBatchable are driven element by element.
+template <typename Gen, typename = void>
+struct IsBatchable : std::false_type {};
+
+template <typename Gen>
+struct IsBatchable<Gen, std::enable_if_t<GeneratorTraits<Gen>::IsBatchable>>
+    : std::true_type {};
+
+// True when the generator implements advance(k), skipping k elements
+// without producing them, and every output maps to exactly one input.
+template <typename Gen, typename = void>
+struct IsSeekable : std::false_type {};
+
+template <typename Gen>
+struct IsSeekable<Gen, std::enable_if_t<GeneratorTraits<Gen>::IsSeekable>>
+    : std::true_type {};
+
+// True when the generator implements splitSize() and slice(begin, len),
+// so that its remaining source positions can be cut into independent
+// contiguous parts whose outputs, concatenated, equal the whole sequence.
+template <typename Gen, typename = void>
+struct IsSplittable : std::false_type {};
+
+template <typename Gen>
+struct IsSplittable<Gen, std::enable_if_t<GeneratorTraits<Gen>::IsSplittable>>
+    : std::true_type {};
+
+// What sizeHint() promises about the number of remaining elements.
+enum class SizeKind {
+  Unknown,    // no sizeHint()
+  UpperBound, // sizeHint() >= remaining elements
+  Exact,      // sizeHint() == remaining elements
+  Infinite,   // never exhausted; no sizeHint()
+};
+
+template <typename Gen, typename = void> struct SizeKindOf {
+  static constexpr SizeKind value = SizeKind::Unknown;
+};
+
+template <typename Gen>
+struct SizeKindOf<Gen, std::void_t<decltype(GeneratorTraits<Gen>::Size)>> {
+  static constexpr SizeKind value = GeneratorTraits<Gen>::Size;
+};
+
+template <typename Gen>
+inline constexpr bool HasSizeHint = SizeKindOf<Gen>::value == SizeKind::Exact
+                                    || SizeKindOf<Gen>::value
+                                           == SizeKind::UpperBound;
+
+template <typename It>
+inline constexpr bool IsRandomAccess = std::is_base_of_v<
+    std::random_access_iterator_tag,
+    typename std::iterator_traits<It>::iterator_category>;
+
 template <typename T> struct GeneratorTraits<RangeGenerator<T>> {
   using ValueType = T;
+  static constexpr bool IsBatchable = IsBatchElement<T>;
+  static constexpr bool IsSeekable = true;
+  static constexpr SizeKind Size = SizeKind::Infinite;
 };
 // template <typename Container>
 // struct GeneratorTraits<ContainerGenerator<Container>> {
@@ -49,21 +156,135 @@ template <template <typename, typename> class Container, typename T,
           typename Alloc>
 struct GeneratorTraits<ContainerGenerator<Container, T, Alloc>> {
   using ValueType = typename Container<T, Alloc>::value_type;
+  static constexpr bool IsBatchable = IsBatchElement<ValueType>;
+  static constexpr bool IsSeekable
+      = IsRandomAccess<typename Container<T, Alloc>::const_iterator>;
+  static constexpr bool IsSplittable = IsSeekable;
+  static constexpr SizeKind Size
+      = IsSeekable ? SizeKind::Exact : SizeKind::Unknown;
 };
 
 template <typename Gen, typename Func>
 struct GeneratorTraits<MapGenerator<Gen, Func>> {
   using SourceT = typename GeneratorTraits<Gen>::ValueType;
   using ValueType = decltype(std::declval<Func>()(std::declval<SourceT>()));
+  static constexpr bool IsBatchable
+      = impl::IsBatchable<Gen>::value && IsBatchElement<ValueType>;
+  static constexpr bool IsSeekable = impl::IsSeekable<Gen>::value;
+  static constexpr bool IsSplittable = impl::IsSplittable<Gen>::value;
+  static constexpr SizeKind Size = SizeKindOf<Gen>::value;
 };
 
 template <typename Gen, typename Pred>
 struct GeneratorTraits<FilterGenerator<Gen, Pred>> {
   using ValueType = typename Gen::ValueType;
+  static constexpr bool IsBatchable = impl::IsBatchable<Gen>::value;
+  static constexpr bool IsSplittable = impl::IsSplittable<Gen>::value;
+  static constexpr SizeKind Size
+      = HasSizeHint<Gen> ? SizeKind::UpperBound : SizeKind::Unknown;
 };
 
+// take(n) over a seekable chain is split by position, which also makes an
+// unbounded RangeGenerator splittable once it is bounded by take().
 template <typename Gen> struct GeneratorTraits<TakeGenerator<Gen>> {
   using ValueType = typename Gen::ValueType;
+  static constexpr bool IsBatchable = impl::IsBatchable<Gen>::value;
+  static constexpr bool IsSeekable = impl::IsSeekable<Gen>::value;
+  static constexpr bool IsSplittable = IsSeekable;
+  static constexpr SizeKind Size
+      = SizeKindOf<Gen>::value == SizeKind::Exact
+                || SizeKindOf<Gen>::value == SizeKind::Infinite
+            ? SizeKind::Exact
+            : SizeKind::UpperBound;
+};
+
+// Stages that may stop early keep at most their source's size.
+template <typename Gen>
+inline constexpr SizeKind ShrunkSizeKind
+    = HasSizeHint<Gen> ? SizeKind::UpperBound : SizeKind::Unknown;
+
+constexpr SizeKind zipSizeKind(SizeKind a, SizeKind b) {
+  auto bounded = [](SizeKind k) {
+    return k == SizeKind::Exact || k == SizeKind::UpperBound;
+  };
+  auto exactOrInfinite = [](SizeKind k) {
+    return k == SizeKind::Exact || k == SizeKind::Infinite;
+  };
+  if (a == SizeKind::Infinite && b == SizeKind::Infinite)
+    return SizeKind::Infinite;
+  if (!bounded(a) && !bounded(b))
+    return SizeKind::Unknown;
+  return exactOrInfinite(a) && exactOrInfinite(b) ? SizeKind::Exact
+                                                  : SizeKind::UpperBound;
+}
+
+template <typename GenA, typename GenB>
+struct GeneratorTraits<ZipGenerator<GenA, GenB>> {
+  using ValueType
+      = std::pair<typename GenA::ValueType, typename GenB::ValueType>;
+  static constexpr bool IsSeekable
+      = impl::IsSeekable<GenA>::value && impl::IsSeekable<GenB>::value;
+  static constexpr SizeKind Size
+      = zipSizeKind(SizeKindOf<GenA>::value, SizeKindOf<GenB>::value);
+};
+
+template <typename Gen> struct GeneratorTraits<EnumerateGenerator<Gen>> {
+  using ValueType = std::pair<std::size_t, typename Gen::ValueType>;
+  static constexpr bool IsSeekable = impl::IsSeekable<Gen>::value;
+  // A slice numbers its elements from its source position, which is the
+  // output index only when every input yields one output.
+  static constexpr bool IsSplittable
+      = impl::IsSeekable<Gen>::value && impl::IsSplittable<Gen>::value;
+  static constexpr SizeKind Size = SizeKindOf<Gen>::value;
+};
+
+// Unwraps a LazyStream returned by a flatMap() callable to its generator.
+template <typename T> struct AsGenerator {
+  using type = T;
+  static const T &get(const T &gen) { return gen; }
+};
+
+template <typename Gen> struct AsGenerator<LazyStream<Gen>> {
+  using type = Gen;
+  static const Gen &get(const LazyStream<Gen> &s) { return s.generator(); }
+};
+
+template <typename Gen, typename Func>
+struct GeneratorTraits<FlatMapGenerator<Gen, Func>> {
+  using SourceT = typename GeneratorTraits<Gen>::ValueType;
+  using InnerGen = typename AsGenerator<
+      std::decay_t<decltype(std::declval<Func>()(std::declval<SourceT>()))>>::
+      type;
+  using ValueType = typename InnerGen::ValueType;
+};
+
+template <typename Gen, typename U, typename Func>
+struct GeneratorTraits<ScanGenerator<Gen, U, Func>> {
+  using ValueType = U;
+  static constexpr bool IsBatchable
+      = impl::IsBatchable<Gen>::value && IsBatchElement<U>;
+  static constexpr SizeKind Size = SizeKindOf<Gen>::value;
+};
+
+template <typename Gen, typename Pred>
+struct GeneratorTraits<TakeWhileGenerator<Gen, Pred>> {
+  using ValueType = typename Gen::ValueType;
+  static constexpr SizeKind Size = ShrunkSizeKind<Gen>;
+};
+
+template <typename Gen, typename Pred>
+struct GeneratorTraits<DropWhileGenerator<Gen, Pred>> {
+  using ValueType = typename Gen::ValueType;
+  static constexpr bool IsBatchable = impl::IsBatchable<Gen>::value;
+  static constexpr SizeKind Size = SizeKindOf<Gen>::value == SizeKind::Infinite
+                                       ? SizeKind::Infinite
+                                       : ShrunkSizeKind<Gen>;
+};
+
+template <typename Gen, std::size_t N>
+struct GeneratorTraits<ChunkGenerator<Gen, N>> {
+  using ValueType = Chunk<typename Gen::ValueType, N>;
+  static constexpr SizeKind Size = SizeKindOf<Gen>::value;
 };
 } // namespace impl
 
@@ -73,6 +294,38 @@ public:
   std::optional<T> next() const {
     return static_cast<const Derived *>(this)->nextImpl();
   }
+
+  // Writes up to n (<= impl::BatchSize) elements to out and returns how many
+  // were written. Short blocks are allowed; 0 means the generator is done.
+  std::size_t nextBatch(T *out, std::size_t n) const {
+    assert(n <= impl::BatchSize);
+    return static_cast<const Derived *>(this)->nextBatchImpl(out, n);
+  }
+
+  // Reference protocol: returns a pointer to the next element in storage
+  // owned by the source (a container, a memoized list), valid as long as
+  // that storage, or nullptr once exhausted. Only generators implementing
+  // nextRefImpl() support it; stages that pass elements through unchanged
+  // forward it from their source.
+  const T *nextRef() const {
+    return static_cast<const Derived *>(this)->nextRefImpl();
+  }
+
+  // Push protocol: feeds elements to sink until the generator is exhausted
+  // or sink returns false. Returns false iff sink requested the stop, so the
+  // signal can propagate back through enclosing stages. Generators without
+  // pushImpl() are adapted from next().
+  template <typename Sink> bool push(Sink &&sink) const {
+    if constexpr (impl::HasMember_pushImpl<Derived, Sink>::value) {
+      return static_cast<const Derived *>(this)->pushImpl(sink);
+    } else {
+      while (auto item = next()) {
+        if (!sink(std::move(*item)))
+          return false;
+      }
+      return true;
+    }
+  }
 };
 
 template <typename T>
@@ -83,6 +336,24 @@ public:
   using ValueType = T;
   explicit RangeGenerator(T start) : current_(start) {}
   std::optional<T> nextImpl() const { return current_++; }
+  std::size_t nextBatchImpl(T *out, std::size_t n) const {
+    for (std::size_t i = 0; i < n; ++i)
+      out[i] = current_++;
+    return n;
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    while (sink(current_++)) {
+    }
+    return false;
+  }
+  void advance(std::size_t k) const {
+    if constexpr (std::is_arithmetic_v<T>) {
+      current_ += static_cast<T>(k);
+    } else {
+      while (k--)
+        ++current_;
+    }
+  }
 };
 
 template <template <typename, typename> class Container, typename T,
@@ -101,6 +372,38 @@ public:
       return std::nullopt;
     return *current_++;
   }
+  template <typename It = Iterator,
+            typename = std::enable_if_t<std::is_lvalue_reference_v<
+                typename std::iterator_traits<It>::reference>>>
+  const ValueType *nextRefImpl() const {
+    return current_ == end_ ? nullptr : &*current_++;
+  }
+  std::size_t nextBatchImpl(ValueType *out, std::size_t n) const {
+    std::size_t i = 0;
+    for (; i < n && current_ != end_; ++i)
+      out[i] = *current_++;
+    return i;
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    for (; current_ != end_; ++current_) {
+      if (!sink(*current_)) {
+        ++current_;
+        return false;
+      }
+    }
+    return true;
+  }
+  void advance(std::size_t k) const {
+    current_ += std::min(static_cast<std::ptrdiff_t>(k), end_ - current_);
+  }
+  std::size_t splitSize() const { return end_ - current_; }
+  std::size_t sizeHint() const { return end_ - current_; }
+  ContainerGenerator slice(std::size_t begin, std::size_t len) const {
+    ContainerGenerator part = *this;
+    part.current_ += begin;
+    part.end_ = part.current_ + len;
+    return part;
+  }
 };
 
 template <typename Gen, typename Func>
@@ -120,6 +423,24 @@ public:
       return func_(*item);
     return std::nullopt;
   }
+  std::size_t nextBatchImpl(U *out, std::size_t n) const {
+    std::array<T, impl::BatchSize> in;
+    std::size_t count = gen_.nextBatch(in.data(), n);
+    for (std::size_t i = 0; i < count; ++i)
+      out[i] = func_(in[i]);
+    return count;
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    return gen_.push([this, &sink](auto &&item) {
+      return sink(func_(std::forward<decltype(item)>(item)));
+    });
+  }
+  void advance(std::size_t k) const { gen_.advance(k); }
+  std::size_t sizeHint() const { return gen_.sizeHint(); }
+  std::size_t splitSize() const { return gen_.splitSize(); }
+  MapGenerator slice(std::size_t begin, std::size_t len) const {
+    return MapGenerator(gen_.slice(begin, len), func_);
+  }
 };
 
 template <typename Gen, typename Pred>
@@ -138,6 +459,40 @@ public:
     }
     return std::nullopt;
   }
+  template <typename G = Gen, typename = std::enable_if_t<
+                                  impl::HasMember_nextRefImpl<G>::value>>
+  const ValueType *nextRefImpl() const {
+    while (auto *item = gen_.nextRef()) {
+      if (pred_(*item))
+        return item;
+    }
+    return nullptr;
+  }
+  // Pulls into out and compacts in place; never pulls more than n elements
+  // beyond what it keeps, so downstream take() does not over-consume.
+  std::size_t nextBatchImpl(ValueType *out, std::size_t n) const {
+    std::size_t kept = 0;
+    while (kept < n) {
+      std::size_t count = gen_.nextBatch(out + kept, n - kept);
+      if (count == 0)
+        break;
+      for (std::size_t i = kept, end = kept + count; i < end; ++i) {
+        if (pred_(out[i]))
+          out[kept++] = out[i];
+      }
+    }
+    return kept;
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    return gen_.push([this, &sink](auto &&item) {
+      return !pred_(item) || sink(std::forward<decltype(item)>(item));
+    });
+  }
+  std::size_t sizeHint() const { return gen_.sizeHint(); }
+  std::size_t splitSize() const { return gen_.splitSize(); }
+  FilterGenerator slice(std::size_t begin, std::size_t len) const {
+    return FilterGenerator(gen_.slice(begin, len), pred_);
+  }
 };
 
 template <typename Gen>
@@ -158,6 +513,361 @@ public:
     }
     return std::nullopt;
   }
+  template <typename G = Gen, typename = std::enable_if_t<
+                                  impl::HasMember_nextRefImpl<G>::value>>
+  const ValueType *nextRefImpl() const {
+    if (remaining_ == 0)
+      return nullptr;
+    auto *item = gen_.nextRef();
+    if (item)
+      --remaining_;
+    return item;
+  }
+  std::size_t nextBatchImpl(ValueType *out, std::size_t n) const {
+    if (remaining_ == 0)
+      return 0;
+    std::size_t count = gen_.nextBatch(out, n < remaining_ ? n : remaining_);
+    remaining_ -= count;
+    return count;
+  }
+  // Reaching the limit ends this stage normally; only a stop requested by
+  // sink is reported upwards.
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    if (remaining_ == 0)
+      return true;
+    bool stopped = false;
+    gen_.push([this, &sink, &stopped](auto &&item) {
+      --remaining_;
+      if (!sink(std::forward<decltype(item)>(item))) {
+        stopped = true;
+        return false;
+      }
+      return remaining_ != 0;
+    });
+    return !stopped;
+  }
+  void advance(std::size_t k) const {
+    k = std::min(k, remaining_);
+    gen_.advance(k);
+    remaining_ -= k;
+  }
+  std::size_t sizeHint() const {
+    if constexpr (impl::HasSizeHint<Gen>) {
+      return std::min(remaining_, gen_.sizeHint());
+    } else {
+      return remaining_;
+    }
+  }
+  std::size_t splitSize() const {
+    if constexpr (impl::IsSplittable<Gen>::value) {
+      return std::min(remaining_, gen_.splitSize());
+    } else {
+      return remaining_;
+    }
+  }
+  TakeGenerator slice(std::size_t begin, std::size_t len) const {
+    TakeGenerator part = *this;
+    part.gen_.advance(begin);
+    part.remaining_ = len;
+    return part;
+  }
+};
+
+template <typename GenA, typename GenB>
+class ZipGenerator : public Generator<ZipGenerator<GenA, GenB>> {
+  mutable GenA first_;
+  mutable GenB second_;
+
+public:
+  using ValueType = typename impl::GeneratorTraits<ZipGenerator>::ValueType;
+  ZipGenerator(GenA first, GenB second)
+      : first_(std::move(first)), second_(std::move(second)) {}
+  std::optional<ValueType> nextImpl() const {
+    auto a = first_.next();
+    if (!a)
+      return std::nullopt;
+    auto b = second_.next();
+    if (!b)
+      return std::nullopt;
+    return ValueType(std::move(*a), std::move(*b));
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    bool stopped = false;
+    first_.push([this, &sink, &stopped](auto &&a) {
+      auto b = second_.next();
+      if (!b)
+        return false;
+      if (!sink(ValueType(std::forward<decltype(a)>(a), std::move(*b)))) {
+        stopped = true;
+        return false;
+      }
+      return true;
+    });
+    return !stopped;
+  }
+  void advance(std::size_t k) const {
+    first_.advance(k);
+    second_.advance(k);
+  }
+  std::size_t sizeHint() const {
+    if constexpr (impl::HasSizeHint<GenA> && impl::HasSizeHint<GenB>) {
+      return std::min(first_.sizeHint(), second_.sizeHint());
+    } else if constexpr (impl::HasSizeHint<GenA>) {
+      return first_.sizeHint();
+    } else {
+      return second_.sizeHint();
+    }
+  }
+};
+
+template <typename Gen>
+class EnumerateGenerator : public Generator<EnumerateGenerator<Gen>> {
+  mutable Gen gen_;
+  mutable std::size_t index_;
+
+public:
+  using ValueType = std::pair<std::size_t, typename Gen::ValueType>;
+  explicit EnumerateGenerator(Gen gen, std::size_t start = 0)
+      : gen_(std::move(gen)), index_(start) {}
+  std::optional<ValueType> nextImpl() const {
+    if (auto item = gen_.next())
+      return ValueType(index_++, std::move(*item));
+    return std::nullopt;
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    return gen_.push([this, &sink](auto &&item) {
+      return sink(ValueType(index_++, std::forward<decltype(item)>(item)));
+    });
+  }
+  void advance(std::size_t k) const {
+    gen_.advance(k);
+    index_ += k;
+  }
+  std::size_t sizeHint() const { return gen_.sizeHint(); }
+  std::size_t splitSize() const { return gen_.splitSize(); }
+  EnumerateGenerator slice(std::size_t begin, std::size_t len) const {
+    return EnumerateGenerator(gen_.slice(begin, len), index_ + begin);
+  }
+};
+
+// func maps each element to a generator or LazyStream whose elements are
+// spliced in place. Inner sequences are held by value, one at a time.
+template <typename Gen, typename Func>
+class FlatMapGenerator : public Generator<FlatMapGenerator<Gen, Func>> {
+  using Traits = impl::GeneratorTraits<FlatMapGenerator>;
+  using InnerGen = typename Traits::InnerGen;
+  using SourceT = typename Traits::SourceT;
+  using Unwrap = impl::AsGenerator<
+      std::decay_t<decltype(std::declval<Func>()(std::declval<SourceT>()))>>;
+
+  mutable Gen gen_;
+  Func func_;
+  mutable std::optional<InnerGen> inner_;
+
+public:
+  using ValueType = typename Traits::ValueType;
+  FlatMapGenerator(Gen gen, Func func)
+      : gen_(std::move(gen)), func_(std::move(func)) {}
+  std::optional<ValueType> nextImpl() const {
+    for (;;) {
+      if (inner_) {
+        if (auto item = inner_->next())
+          return item;
+        inner_.reset();
+      }
+      auto outer = gen_.next();
+      if (!outer)
+        return std::nullopt;
+      inner_.emplace(Unwrap::get(func_(*outer)));
+    }
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    if (inner_) {
+      bool completed = inner_->push(sink);
+      inner_.reset();
+      if (!completed)
+        return false;
+    }
+    return gen_.push([this, &sink](auto &&item) {
+      InnerGen inner(Unwrap::get(func_(std::forward<decltype(item)>(item))));
+      return inner.push(sink);
+    });
+  }
+};
+
+// Yields the running accumulation func(...func(func(init, x0), x1)..., xi)
+// for each element xi, i.e. an inclusive scan that does not emit init.
+template <typename Gen, typename U, typename Func>
+class ScanGenerator : public Generator<ScanGenerator<Gen, U, Func>> {
+  using T = typename Gen::ValueType;
+
+  mutable Gen gen_;
+  mutable U acc_;
+  Func func_;
+
+public:
+  using ValueType = U;
+  ScanGenerator(Gen gen, U init, Func func)
+      : gen_(std::move(gen)), acc_(std::move(init)), func_(std::move(func)) {}
+  std::optional<U> nextImpl() const {
+    if (auto item = gen_.next()) {
+      acc_ = func_(std::move(acc_), *item);
+      return acc_;
+    }
+    return std::nullopt;
+  }
+  std::size_t nextBatchImpl(U *out, std::size_t n) const {
+    std::array<T, impl::BatchSize> in;
+    std::size_t count = gen_.nextBatch(in.data(), n);
+    for (std::size_t i = 0; i < count; ++i)
+      out[i] = acc_ = func_(acc_, in[i]);
+    return count;
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    return gen_.push([this, &sink](auto &&item) {
+      acc_ = func_(std::move(acc_), std::forward<decltype(item)>(item));
+      return sink(static_cast<const U &>(acc_));
+    });
+  }
+  std::size_t sizeHint() const { return gen_.sizeHint(); }
+};
+
+template <typename Gen, typename Pred>
+class TakeWhileGenerator : public Generator<TakeWhileGenerator<Gen, Pred>> {
+  mutable Gen gen_;
+  Pred pred_;
+  mutable bool done_ = false;
+
+public:
+  using ValueType = typename Gen::ValueType;
+  TakeWhileGenerator(Gen gen, Pred pred)
+      : gen_(std::move(gen)), pred_(std::move(pred)) {}
+  std::optional<ValueType> nextImpl() const {
+    if (done_)
+      return std::nullopt;
+    auto item = gen_.next();
+    if (item && pred_(*item))
+      return item;
+    done_ = true;
+    return std::nullopt;
+  }
+  template <typename G = Gen, typename = std::enable_if_t<
+                                  impl::HasMember_nextRefImpl<G>::value>>
+  const ValueType *nextRefImpl() const {
+    if (done_)
+      return nullptr;
+    auto *item = gen_.nextRef();
+    if (item && pred_(*item))
+      return item;
+    done_ = true;
+    return nullptr;
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    if (done_)
+      return true;
+    bool stopped = false;
+    bool completed = gen_.push([this, &sink, &stopped](auto &&item) {
+      if (!pred_(item))
+        return false;
+      if (!sink(std::forward<decltype(item)>(item))) {
+        stopped = true;
+        return false;
+      }
+      return true;
+    });
+    done_ = completed || !stopped;
+    return !stopped;
+  }
+  std::size_t sizeHint() const { return done_ ? 0 : gen_.sizeHint(); }
+};
+
+template <typename Gen, typename Pred>
+class DropWhileGenerator : public Generator<DropWhileGenerator<Gen, Pred>> {
+  mutable Gen gen_;
+  Pred pred_;
+  mutable bool dropping_ = true;
+
+public:
+  using ValueType = typename Gen::ValueType;
+  DropWhileGenerator(Gen gen, Pred pred)
+      : gen_(std::move(gen)), pred_(std::move(pred)) {}
+  std::optional<ValueType> nextImpl() const {
+    auto item = gen_.next();
+    while (dropping_ && item && pred_(*item))
+      item = gen_.next();
+    dropping_ = false;
+    return item;
+  }
+  template <typename G = Gen, typename = std::enable_if_t<
+                                  impl::HasMember_nextRefImpl<G>::value>>
+  const ValueType *nextRefImpl() const {
+    auto *item = gen_.nextRef();
+    while (dropping_ && item && pred_(*item))
+      item = gen_.nextRef();
+    dropping_ = false;
+    return item;
+  }
+  std::size_t nextBatchImpl(ValueType *out, std::size_t n) const {
+    std::size_t count = gen_.nextBatch(out, n);
+    while (dropping_ && count != 0) {
+      auto first = std::find_if_not(out, out + count, std::cref(pred_));
+      if (first != out + count) {
+        dropping_ = false;
+        count = std::copy(first, out + count, out) - out;
+      } else {
+        count = gen_.nextBatch(out, n);
+      }
+    }
+    return count;
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    return gen_.push([this, &sink](auto &&item) {
+      if (dropping_ && pred_(item))
+        return true;
+      dropping_ = false;
+      return sink(std::forward<decltype(item)>(item));
+    });
+  }
+  std::size_t sizeHint() const { return gen_.sizeHint(); }
+};
+
+template <typename Gen, std::size_t N>
+class ChunkGenerator : public Generator<ChunkGenerator<Gen, N>> {
+  static_assert(N > 0, "Chunk size must be positive");
+
+  mutable Gen gen_;
+
+public:
+  using ValueType = Chunk<typename Gen::ValueType, N>;
+  explicit ChunkGenerator(Gen gen) : gen_(std::move(gen)) {}
+  std::optional<ValueType> nextImpl() const {
+    ValueType chunk;
+    while (chunk.count < N) {
+      auto item = gen_.next();
+      if (!item)
+        break;
+      chunk.items[chunk.count++] = std::move(*item);
+    }
+    if (chunk.empty())
+      return std::nullopt;
+    return chunk;
+  }
+  template <typename Sink> bool pushImpl(Sink &sink) const {
+    ValueType chunk;
+    bool stopped = false;
+    gen_.push([&sink, &chunk, &stopped](auto &&item) {
+      chunk.items[chunk.count++] = std::forward<decltype(item)>(item);
+      if (chunk.count < N)
+        return true;
+      stopped = !sink(static_cast<const ValueType &>(chunk));
+      chunk.count = 0;
+      return !stopped;
+    });
+    if (!stopped && !chunk.empty())
+      stopped = !sink(static_cast<const ValueType &>(chunk));
+    return !stopped;
+  }
+  std::size_t sizeHint() const { return (gen_.sizeHint() + N - 1) / N; }
 };
 
 template <typename Gen> class LazyStream {
@@ -165,6 +875,7 @@ template <typename Gen> class LazyStream {
 
 public:
   using ValueType = typename Gen::ValueType;
+  using GeneratorType = Gen;
 
   LazyStream(Gen &&gen) : generator_(std::forward<Gen>(gen)) {}
 
@@ -186,68 +897,312 @@ public:
     return LazyStream<TakenGen>(TakenGen(generator_, n));
   }
 
+  // Pairs elements with those of other; ends with the shorter stream.
+  template <typename OtherGen>
+  auto zip(const LazyStream<OtherGen> &other) const {
+    using ZippedGen = ZipGenerator<Gen, OtherGen>;
+    return LazyStream<ZippedGen>(ZippedGen(generator_, other.generator()));
+  }
+
+  // Pairs every element with its zero-based position.
+  auto enumerate() const {
+    using EnumeratedGen = EnumerateGenerator<Gen>;
+    return LazyStream<EnumeratedGen>(EnumeratedGen(generator_));
+  }
+
+  // f returns a generator or LazyStream for each element; their elements
+  // are produced in order without materializing them.
+  template <typename Func> auto flatMap(Func &&f) const {
+    using F = std::decay_t<Func>;
+    using FlatGen = FlatMapGenerator<Gen, F>;
+    return LazyStream<FlatGen>(FlatGen(generator_, std::forward<Func>(f)));
+  }
+
+  template <typename U, typename Func> auto scan(U init, Func &&f) const {
+    using F = std::decay_t<Func>;
+    using ScannedGen = ScanGenerator<Gen, U, F>;
+    return LazyStream<ScannedGen>(
+        ScannedGen(generator_, std::move(init), std::forward<Func>(f)));
+  }
+
+  template <typename Pred> auto takeWhile(Pred &&p) const {
+    using P = std::decay_t<Pred>;
+    using TakenGen = TakeWhileGenerator<Gen, P>;
+    return LazyStream<TakenGen>(TakenGen(generator_, std::forward<Pred>(p)));
+  }
+
+  template <typename Pred> auto dropWhile(Pred &&p) const {
+    using P = std::decay_t<Pred>;
+    using DroppedGen = DropWhileGenerator<Gen, P>;
+    return LazyStream<DroppedGen>(
+        DroppedGen(generator_, std::forward<Pred>(p)));
+  }
+
+  // Groups consecutive elements into Chunk<ValueType, N> blocks.
+  template <std::size_t N> auto chunk() const {
+    using ChunkedGen = ChunkGenerator<Gen, N>;
+    return LazyStream<ChunkedGen>(ChunkedGen(generator_));
+  }
+
+  const Gen &generator() const { return generator_; }
+
+  // Reductions recognised by simd.hpp (ops::sum, std::plus, ops::min,
+  // ops::max, ops::countIf, optionally wrapped in reassociate()) over
+  // arithmetic elements run a vector kernel over each block of elements.
   template <typename U, typename Reducer> U reduce(U init, Reducer &&r) const {
-    auto copy = generator_;
-    while (auto item = copy.next()) {
-      init = r(init, *item);
+    using Op = std::decay_t<Reducer>;
+    if constexpr (impl::simd::Vectorizable<Op, U, ValueType>
+                  && impl::IsBatchable<Gen>::value) {
+      auto copy = generator_;
+      std::array<ValueType, impl::BatchSize> block;
+      while (std::size_t count = copy.nextBatch(block.data(), block.size()))
+        init = impl::simd::reduce(r, std::move(init), block.data(), count);
+      return init;
+    } else if constexpr (impl::simd::Vectorizable<Op, U, ValueType>) {
+      impl::simd::BlockReducer<Op, U, ValueType> reducer(r, std::move(init));
+      consume([&](const ValueType &item) { reducer.push(item); });
+      return reducer.finish();
+    } else {
+      consume([&](const ValueType &item) { init = r(init, item); });
+      return init;
     }
-    return init;
   }
 
   template <typename Func> void forEach(Func &&f) const {
-    auto copy = generator_;
-    while (auto item = copy.next()) {
-      f(*item);
-    }
+    consume([&](const ValueType &item) { f(item); });
   }
 
+  // The k first elements in compare order of keyFn(element), ties going
+  // to the earlier element. One pass keeps the best k seen so far in a
+  // heap, so memory is O(k) however long the (finite) stream is.
+  template <typename Container = std::vector<ValueType>, typename KeyFn,
+            typename Compare = std::less<>>
+  Container topK(std::size_t k, KeyFn keyFn,
+                 Compare compare = Compare()) const {
+    using Key = std::decay_t<std::invoke_result_t<KeyFn &, const ValueType &>>;
+    impl::TopKHeap<ValueType, Key, Compare> heap(k, std::move(compare));
+    consume([&](const ValueType &item) { heap.push(keyFn(item), item); });
+    return std::move(heap).template finish<Container>();
+  }
+
+  // Collecting into an ArenaVector places the result in the current
+  // ArenaScope.
   template <typename Container> Container collect() const {
-    auto copy = generator_;
+    static_assert(impl::HasMember_push_back<Container>::value
+                      || impl::HasMember_insert<Container>::value,
+                  "Container must have push_back or insert");
     Container container;
-    while (auto item = copy.next()) {
+    reserveFor(container, generator_);
+    consume([&](const ValueType &item) {
       if constexpr (impl::HasMember_push_back<Container>::value) {
-        container.push_back(*item);
-      } else if constexpr (impl::HasMember_insert<Container>::value) {
-        container.insert(container.end(), *item);
+        container.push_back(item);
+      } else {
+        container.insert(container.end(), item);
+      }
+    });
+    return container;
+  }
+
+  // Parallel terminal operations for chains over a splittable source: a
+  // random-access ContainerGenerator, or a seekable source bounded by take().
+  // The source is cut into one contiguous part per worker, each part runs
+  // the fused chain, and per-part results are combined in source order.
+
+  // identity must be a neutral element of combine, and combine must be
+  // associative; reducer folds elements into a per-part accumulator.
+  template <typename U, typename Reducer, typename Combiner>
+  U parallelReduce(U identity, Reducer &&reducer, Combiner &&combine) const {
+    std::size_t parts = partitionCount();
+    std::vector<std::optional<U>> partials(parts);
+    runParts(parts, [&](std::size_t i, const LazyStream &part) {
+      partials[i].emplace(part.reduce(identity, reducer));
+    });
+    U result = std::move(*partials[0]);
+    for (std::size_t i = 1; i < parts; ++i)
+      result = combine(std::move(result), std::move(*partials[i]));
+    return result;
+  }
+
+  // Shorthand for reductions whose accumulator and element types agree,
+  // such as sums: reducer doubles as the combining function.
+  template <typename U, typename Reducer>
+  U parallelReduce(U identity, Reducer &&reducer) const {
+    return parallelReduce(std::move(identity), reducer, reducer);
+  }
+
+  // f is called concurrently from several threads, in unspecified order.
+  template <typename Func> void parallelForEach(Func &&f) const {
+    runParts(partitionCount(), [&f](std::size_t, const LazyStream &part) {
+      part.forEach(f);
+    });
+  }
+
+  template <typename Container> Container parallelCollect() const {
+    std::size_t parts = partitionCount();
+    std::vector<Container> results(parts);
+    runParts(parts, [&results](std::size_t i, const LazyStream &part) {
+      results[i] = part.template collect<Container>();
+    });
+    Container container = std::move(results[0]);
+    if constexpr (impl::HasMember_reserve<Container>::value) {
+      std::size_t total = 0;
+      for (const auto &result : results)
+        total += result.size();
+      container.reserve(total);
+    }
+    for (std::size_t i = 1; i < parts; ++i) {
+      if constexpr (impl::HasMember_insert<Container>::value) {
+        container.insert(container.end(),
+                         std::make_move_iterator(results[i].begin()),
+                         std::make_move_iterator(results[i].end()));
       } else {
-        static_assert(impl::HasMember_push_back<Container>::value
-                          || impl::HasMember_insert<Container>::value,
-                      "Container must have push_back or insert");
+        for (auto &item : results[i])
+          container.push_back(std::move(item));
       }
     }
     return container;
   }
 
+private:
+  // Reserves room for an exact size hint, so collecting a sized source
+  // does not reallocate as it grows. An upper bound only seeds a capped
+  // reservation.
+  template <typename Container>
+  static void reserveFor(Container &container, const Gen &gen) {
+    constexpr impl::SizeKind Size = impl::SizeKindOf<Gen>::value;
+    if constexpr (!impl::HasMember_reserve<Container>::value) {
+      return;
+    } else if constexpr (Size == impl::SizeKind::Exact) {
+      container.reserve(gen.sizeHint());
+    } else if constexpr (Size == impl::SizeKind::UpperBound) {
+      impl::reserveBound(container, gen.sizeHint());
+    }
+  }
+
+  std::size_t partitionCount() const {
+    static_assert(impl::IsSplittable<Gen>::value,
+                  "Parallel operations need a splittable source: a "
+                  "random-access ContainerGenerator or a take() bound");
+    return impl::partitionCount(generator_.splitSize());
+  }
+
+  template <typename Body> void runParts(std::size_t parts, Body &&body) const {
+    std::size_t size = generator_.splitSize();
+    impl::parallelFor(parts, [&](std::size_t i) {
+      std::size_t begin = size * i / parts;
+      std::size_t end = size * (i + 1) / parts;
+      body(i, LazyStream(generator_.slice(begin, end - begin)));
+    });
+  }
+
+  // Runs a fresh copy of the chain to completion, feeding every element to
+  // sink. Chains whose stages all support nextBatch() are pulled a block at
+  // a time so inner loops run over contiguous memory; all other chains are
+  // driven by push, with the source calling a fused chain of stage lambdas.
+  // Neither path builds a std::optional per element.
+  template <typename Sink> void consume(Sink &&sink) const {
+    auto copy = generator_;
+    if constexpr (impl::IsBatchable<Gen>::value) {
+      std::array<ValueType, impl::BatchSize> block;
+      while (std::size_t count = copy.nextBatch(block.data(), block.size())) {
+        for (std::size_t i = 0; i < count; ++i)
+          sink(block[i]);
+      }
+    } else {
+      copy.push([&sink](auto &&item) {
+        sink(std::forward<decltype(item)>(item));
+        return true;
+      });
+    }
+  }
+
+  // Each begin() runs its own copy of the chain in a cursor, so every
+  // loop starts from the beginning like the terminal operations do, loops
+  // may nest or run on several threads, and the stream itself is never
+  // modified. Iterators are shared handles onto their cursor: copying one
+  // copies a pointer, never the chain, and incrementing one advances all
+  // its copies, as for any input iterator. When the chain supports
+  // nextRef(), elements are referenced where the source stores them;
+  // otherwise the cursor keeps the element produced by the last stage,
+  // moved in rather than copied. end() is an exhausted iterator rather
+  // than a separate sentinel type, so the stream is a common range usable
+  // with <algorithm>.
+  struct Cursor {
+    static constexpr bool ByReference = impl::HasMember_nextRefImpl<Gen>::value;
+    using Slot = std::conditional_t<ByReference, const ValueType *,
+                                    std::optional<ValueType>>;
+
+    Gen generator;
+    Slot current{};
+
+    explicit Cursor(const Gen &gen) : generator(gen) { fetch(); }
+
+    void fetch() {
+      if constexpr (ByReference) {
+        current = generator.nextRef();
+      } else {
+        current = generator.next();
+      }
+    }
+  };
+
+public:
   class Iterator {
-    const Gen *generator_;
-    std::optional<ValueType> current_;
+    std::shared_ptr<Cursor> cursor_;
+
+    bool done() const { return !cursor_ || !cursor_->current; }
+
+    // What it++ returns: the element it referred to, kept alive after the
+    // cursor has moved on.
+    class Postfix {
+      ValueType value_;
+
+    public:
+      explicit Postfix(const ValueType &value) : value_(value) {}
+      const ValueType &operator*() const { return value_; }
+    };
 
   public:
-    using Reference = const ValueType &;
-    using Pointer = const ValueType *;
-    using IteratorCategory = std::input_iterator_tag;
-    using DifferenceType = std::ptrdiff_t;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = ValueType;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const ValueType *;
+    using reference = const ValueType &;
+
+    using Reference = reference;
+    using Pointer = pointer;
+    using IteratorCategory = iterator_category;
+    using DifferenceType = difference_type;
 
-    explicit Iterator(const Gen *gen)
-        : generator_(gen), current_(generator_->next()) {}
+    explicit Iterator(std::shared_ptr<Cursor> cursor)
+        : cursor_(std::move(cursor)) {}
 
-    Iterator() : generator_(nullptr), current_(std::nullopt) {}
+    Iterator() = default;
 
-    Reference operator*() const { return *current_; }
-    Pointer operator->() const { return &*current_; }
+    reference operator*() const { return *cursor_->current; }
+    pointer operator->() const { return &**this; }
 
     Iterator &operator++() {
-      current_ = generator_->next();
+      cursor_->fetch();
       return *this;
     }
+    Postfix operator++(int) {
+      Postfix old(**this);
+      cursor_->fetch();
+      return old;
+    }
 
+    // Handles onto one cursor are at the same position; otherwise only
+    // exhausted iterators compare equal.
     bool operator==(const Iterator &other) const {
-      return (!current_ && !other.current_);
+      return cursor_ == other.cursor_ || (done() && other.done());
     }
     bool operator!=(const Iterator &other) const { return !(*this == other); }
   };
 
-  Iterator begin() const { return Iterator(&generator_); }
+  Iterator begin() const {
+    return Iterator(std::make_shared<Cursor>(generator_));
+  }
   Iterator end() const { return Iterator(); }
 };
 
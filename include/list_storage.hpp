@@ -0,0 +1,563 @@
+#pragma once
+#ifndef CASKELL_LIST_STORAGE_HPP
+#define CASKELL_LIST_STORAGE_HPP
+
+#include "arena.hpp"
+#include "finger_tree.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace caskell {
+
+// Storage policies for List<T, Storage>. A policy names the container a
+// list keeps its elements in (Container<T>), a Builder<T> that appends
+// elements while a new list is produced, and the operations that derive
+// one list from another: tail, init, cons, snoc, concat and splitAt, and
+// index, which reads one element. Persistent
+// containers implement these by sharing structure; plain sequences copy.
+
+namespace impl {
+
+// The operations of sequence containers with push_back and insert.
+struct SequenceStorage {
+  template <typename C> static C tail(const C &xs) {
+    return xs.empty() ? C() : C(std::next(xs.begin()), xs.end());
+  }
+
+  template <typename C> static C init(const C &xs) {
+    return xs.empty() ? C() : C(xs.begin(), std::prev(xs.end()));
+  }
+
+  template <typename C, typename T> static C cons(T &&x, const C &xs) {
+    C result = xs;
+    result.insert(result.begin(), std::forward<T>(x));
+    return result;
+  }
+
+  template <typename C> static C concat(const C &xs, const C &ys) {
+    C result = xs;
+    result.insert(result.end(), ys.begin(), ys.end());
+    return result;
+  }
+
+  template <typename C, typename T> static C snoc(const C &xs, T &&x) {
+    C result = xs;
+    result.push_back(std::forward<T>(x));
+    return result;
+  }
+
+  template <typename C>
+  static std::pair<C, C> splitAt(const C &xs, std::size_t n) {
+    auto middle = std::next(xs.begin(), std::min(n, xs.size()));
+    return {C(xs.begin(), middle), C(middle, xs.end())};
+  }
+
+  template <typename C>
+  static const typename C::value_type &index(const C &xs, std::size_t i) {
+    return xs[i];
+  }
+
+  template <typename C> class SequenceBuilder {
+    C items_;
+
+  public:
+    template <typename U> void push_back(U &&x) {
+      items_.push_back(std::forward<U>(x));
+    }
+
+    template <typename It> void append(It first, It last) {
+      items_.insert(items_.end(), first, last);
+    }
+
+    C finish() && { return std::move(items_); }
+  };
+};
+
+// An immutable singly-linked list whose cells are shared between the lists
+// that contain them, as in Haskell: tail() and cons() are O(1) and copy no
+// elements. Cells are reference counted and allocated from the current
+// ArenaScope, if any. Elements cannot be modified through iterators, since
+// other lists may share them.
+template <typename T> class ConsCells {
+  struct Cell {
+    T value;
+    std::shared_ptr<Cell> next;
+  };
+
+  std::shared_ptr<Cell> head_;
+  std::size_t size_ = 0;
+
+  ConsCells(std::shared_ptr<Cell> head, std::size_t size)
+      : head_(std::move(head)), size_(size) {}
+
+  template <typename U>
+  static std::shared_ptr<Cell> makeCell(U &&value, std::shared_ptr<Cell> next) {
+    return std::allocate_shared<Cell>(ArenaAllocator<Cell>(),
+                                      Cell{std::forward<U>(value),
+                                           std::move(next)});
+  }
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using reference = const T &;
+  using const_reference = const T &;
+
+  class const_iterator {
+    const Cell *cell_ = nullptr;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T *;
+    using reference = const T &;
+
+    const_iterator() = default;
+    explicit const_iterator(const Cell *cell) : cell_(cell) {}
+
+    reference operator*() const { return cell_->value; }
+    pointer operator->() const { return &cell_->value; }
+
+    const_iterator &operator++() {
+      cell_ = cell_->next.get();
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator it = *this;
+      ++*this;
+      return it;
+    }
+
+    friend bool operator==(const const_iterator &lhs,
+                           const const_iterator &rhs) {
+      return lhs.cell_ == rhs.cell_;
+    }
+    friend bool operator!=(const const_iterator &lhs,
+                           const const_iterator &rhs) {
+      return lhs.cell_ != rhs.cell_;
+    }
+  };
+
+  using iterator = const_iterator;
+
+  // Appends cells front to back; they are private to the builder until
+  // finish() hands them over.
+  class Builder {
+    ConsCells cells_;
+    Cell *last_ = nullptr;
+
+  public:
+    template <typename U> void push_back(U &&x) {
+      auto cell = makeCell(std::forward<U>(x), nullptr);
+      Cell *raw = cell.get();
+      (last_ ? last_->next : cells_.head_) = std::move(cell);
+      last_ = raw;
+      ++cells_.size_;
+    }
+
+    template <typename It> void append(It first, It last) {
+      for (; first != last; ++first)
+        push_back(*first);
+    }
+
+    ConsCells finish() && { return std::move(cells_); }
+
+    // The built cells followed by those of rest, which are shared.
+    ConsCells finish(const ConsCells &rest) && {
+      if (!last_)
+        return rest;
+      last_->next = rest.head_;
+      cells_.size_ += rest.size_;
+      return std::move(cells_);
+    }
+  };
+
+  ConsCells() = default;
+
+  ConsCells(T head, const ConsCells &tail)
+      : head_(makeCell(std::move(head), tail.head_)), size_(tail.size_ + 1) {}
+
+  template <typename It, typename = typename std::iterator_traits<
+                             It>::iterator_category>
+  ConsCells(It first, It last) {
+    Builder builder;
+    builder.append(first, last);
+    *this = std::move(builder).finish();
+  }
+
+  ConsCells(std::initializer_list<T> init)
+      : ConsCells(init.begin(), init.end()) {}
+
+  ConsCells(const ConsCells &) = default;
+  ConsCells(ConsCells &&other) noexcept
+      : head_(std::move(other.head_)), size_(std::exchange(other.size_, 0)) {}
+
+  // Assigning through a temporary makes the destructor release the old
+  // cells.
+  ConsCells &operator=(ConsCells other) noexcept {
+    head_.swap(other.head_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+
+  // Releases unshared cells one at a time instead of recursively, so long
+  // lists do not exhaust the stack.
+  ~ConsCells() {
+    std::shared_ptr<Cell> cell = std::move(head_);
+    while (cell && cell.use_count() == 1)
+      cell = std::move(cell->next);
+  }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const T &front() const { return head_->value; }
+
+  const T &back() const {
+    const Cell *cell = head_.get();
+    while (cell->next)
+      cell = cell->next.get();
+    return cell->value;
+  }
+
+  const_iterator begin() const { return const_iterator(head_.get()); }
+  const_iterator end() const { return const_iterator(); }
+
+  ConsCells tail() const {
+    return empty() ? ConsCells() : ConsCells(head_->next, size_ - 1);
+  }
+
+  void push_front(T x) {
+    head_ = makeCell(std::move(x), std::move(head_));
+    ++size_;
+  }
+
+  friend bool operator==(const ConsCells &lhs, const ConsCells &rhs) {
+    if (lhs.size_ != rhs.size_)
+      return false;
+    const Cell *a = lhs.head_.get();
+    const Cell *b = rhs.head_.get();
+    for (; a != b; a = a->next.get(), b = b->next.get()) {
+      if (!(a->value == b->value))
+        return false;
+    }
+    return true;
+  }
+
+  friend bool operator!=(const ConsCells &lhs, const ConsCells &rhs) {
+    return !(lhs == rhs);
+  }
+};
+
+// A vector that keeps up to N elements in place and moves them to a heap
+// buffer, taken from the current ArenaScope if any, only when it grows
+// beyond that. Lists of at most N elements thus never allocate.
+template <typename T, std::size_t N> class SmallVector {
+  static_assert(N > 0, "SmallVector needs an inline capacity");
+
+  alignas(T) unsigned char inline_[N * sizeof(T)];
+  T *data_;
+  std::size_t size_ = 0;
+  std::size_t capacity_ = N;
+  ArenaAllocator<T> alloc_;
+
+  T *inlineData() { return reinterpret_cast<T *>(inline_); }
+  bool isInline() const {
+    return data_ == reinterpret_cast<const T *>(inline_);
+  }
+
+  void releaseHeap() {
+    if (!isInline())
+      alloc_.deallocate(data_, capacity_);
+    data_ = inlineData();
+    capacity_ = N;
+  }
+
+  // Leaves other empty. Heap buffers change hands; inline elements are
+  // moved one by one.
+  void take(SmallVector &other) {
+    if (other.isInline()) {
+      std::uninitialized_move(other.begin(), other.end(), data_);
+      size_ = other.size_;
+      other.clear();
+    } else {
+      alloc_ = other.alloc_;
+      data_ = std::exchange(other.data_, other.inlineData());
+      size_ = std::exchange(other.size_, 0);
+      capacity_ = std::exchange(other.capacity_, N);
+    }
+  }
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using reference = T &;
+  using const_reference = const T &;
+  using iterator = T *;
+  using const_iterator = const T *;
+  using allocator_type = ArenaAllocator<T>;
+
+  SmallVector() noexcept : data_(inlineData()) {}
+
+  template <typename It, typename = typename std::iterator_traits<
+                             It>::iterator_category>
+  SmallVector(It first, It last) : SmallVector() {
+    insert(end(), first, last);
+  }
+
+  SmallVector(std::initializer_list<T> init)
+      : SmallVector(init.begin(), init.end()) {}
+
+  SmallVector(const SmallVector &other)
+      : data_(inlineData()),
+        alloc_(other.alloc_.select_on_container_copy_construction()) {
+    reserve(other.size_);
+    std::uninitialized_copy(other.begin(), other.end(), data_);
+    size_ = other.size_;
+  }
+
+  SmallVector(SmallVector &&other) noexcept(
+      std::is_nothrow_move_constructible_v<T>)
+      : data_(inlineData()) {
+    take(other);
+  }
+
+  SmallVector &operator=(const SmallVector &other) {
+    if (this != &other) {
+      clear();
+      reserve(other.size_);
+      std::uninitialized_copy(other.begin(), other.end(), data_);
+      size_ = other.size_;
+    }
+    return *this;
+  }
+
+  SmallVector &operator=(SmallVector &&other) noexcept(
+      std::is_nothrow_move_constructible_v<T>) {
+    if (this != &other) {
+      clear();
+      releaseHeap();
+      take(other);
+    }
+    return *this;
+  }
+
+  ~SmallVector() {
+    clear();
+    releaseHeap();
+  }
+
+  std::size_t size() const { return size_; }
+  std::size_t capacity() const { return capacity_; }
+  bool empty() const { return size_ == 0; }
+  allocator_type get_allocator() const { return alloc_; }
+
+  T *data() { return data_; }
+  const T *data() const { return data_; }
+  T &operator[](std::size_t i) { return data_[i]; }
+  const T &operator[](std::size_t i) const { return data_[i]; }
+  T &front() { return data_[0]; }
+  const T &front() const { return data_[0]; }
+  T &back() { return data_[size_ - 1]; }
+  const T &back() const { return data_[size_ - 1]; }
+
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+  void reserve(std::size_t count) {
+    if (count <= capacity_)
+      return;
+    std::size_t capacity = std::max(count, 2 * capacity_);
+    T *data = alloc_.allocate(capacity);
+    for (std::size_t i = 0; i < size_; ++i) {
+      ::new (static_cast<void *>(data + i))
+          T(std::move_if_noexcept(data_[i]));
+      data_[i].~T();
+    }
+    releaseHeap();
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  void clear() {
+    std::destroy(begin(), end());
+    size_ = 0;
+  }
+
+  template <typename... Args> T &emplace_back(Args &&...args) {
+    if (size_ == capacity_) {
+      // The arguments may refer to elements that growing would move.
+      T item(std::forward<Args>(args)...);
+      reserve(size_ + 1);
+      ::new (static_cast<void *>(data_ + size_)) T(std::move(item));
+    } else {
+      ::new (static_cast<void *>(data_ + size_))
+          T(std::forward<Args>(args)...);
+    }
+    return data_[size_++];
+  }
+
+  void push_back(const T &x) { emplace_back(x); }
+  void push_back(T &&x) { emplace_back(std::move(x)); }
+
+  template <typename U> iterator insert(const_iterator pos, U &&x) {
+    std::size_t index = pos - data_;
+    emplace_back(std::forward<U>(x));
+    std::rotate(begin() + index, end() - 1, end());
+    return begin() + index;
+  }
+
+  // first and last must not point into this vector.
+  template <typename It>
+  iterator insert(const_iterator pos, It first, It last) {
+    std::size_t index = pos - data_;
+    std::size_t oldSize = size_;
+    if constexpr (std::is_base_of_v<
+                      std::forward_iterator_tag,
+                      typename std::iterator_traits<It>::iterator_category>) {
+      reserve(size_ + std::distance(first, last));
+    }
+    for (; first != last; ++first)
+      emplace_back(*first);
+    std::rotate(begin() + index, begin() + oldSize, end());
+    return begin() + index;
+  }
+
+  friend bool operator==(const SmallVector &lhs, const SmallVector &rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+  }
+
+  friend bool operator!=(const SmallVector &lhs, const SmallVector &rhs) {
+    return !(lhs == rhs);
+  }
+};
+
+} // namespace impl
+
+// A std::deque per list; the default. Deriving a list copies it.
+struct DequeStorage : impl::SequenceStorage {
+  template <typename T> using Container = std::deque<T>;
+  template <typename T> using Builder = SequenceBuilder<Container<T>>;
+};
+
+// A std::deque allocating from the current ArenaScope, so lists derived
+// inside a scope are freed with it. Otherwise as DequeStorage.
+struct ArenaStorage : impl::SequenceStorage {
+  template <typename T> using Container = std::deque<T, ArenaAllocator<T>>;
+  template <typename T> using Builder = SequenceBuilder<Container<T>>;
+};
+
+// Up to N elements stored inside the list itself, more on the heap. The
+// empty and singleton lists that nondeterministic code returns by the
+// thousand then allocate nothing; deriving a list copies it, as with
+// DequeStorage.
+template <std::size_t N> struct SmallStorage : impl::SequenceStorage {
+  template <typename T> using Container = impl::SmallVector<T, N>;
+  template <typename T> using Builder = SequenceBuilder<Container<T>>;
+};
+
+// Shared cons cells: head, tail and cons are O(1) and allocate nothing for
+// existing elements, which suits recursion over qs.tail(). init, last,
+// snoc, indexing, splitAt and the left operand of + take O(n).
+struct ConsStorage {
+  template <typename T> using Container = impl::ConsCells<T>;
+  template <typename T> using Builder = typename impl::ConsCells<T>::Builder;
+
+  template <typename C> static C tail(const C &xs) { return xs.tail(); }
+
+  template <typename C> static C init(const C &xs) {
+    typename C::Builder builder;
+    std::size_t count = xs.empty() ? 0 : xs.size() - 1;
+    auto it = xs.begin();
+    for (std::size_t i = 0; i < count; ++i, ++it)
+      builder.push_back(*it);
+    return std::move(builder).finish();
+  }
+
+  template <typename C, typename T> static C cons(T &&x, const C &xs) {
+    return C(std::forward<T>(x), xs);
+  }
+
+  // Copies the cells of xs and shares those of ys.
+  template <typename C> static C concat(const C &xs, const C &ys) {
+    typename C::Builder builder;
+    builder.append(xs.begin(), xs.end());
+    return std::move(builder).finish(ys);
+  }
+
+  template <typename C, typename T> static C snoc(const C &xs, T &&x) {
+    typename C::Builder builder;
+    builder.append(xs.begin(), xs.end());
+    builder.push_back(std::forward<T>(x));
+    return std::move(builder).finish();
+  }
+
+  // Copies the first n cells and shares the rest.
+  template <typename C>
+  static std::pair<C, C> splitAt(const C &xs, std::size_t n) {
+    typename C::Builder builder;
+    C rest = xs;
+    for (; n > 0 && !rest.empty(); --n) {
+      builder.push_back(rest.front());
+      rest = rest.tail();
+    }
+    return {std::move(builder).finish(), std::move(rest)};
+  }
+
+  template <typename C>
+  static const typename C::value_type &index(const C &xs, std::size_t i) {
+    return *std::next(xs.begin(), i);
+  }
+};
+
+// A finger tree (see finger_tree.hpp): cons, snoc, tail and init in
+// amortized O(1), and +, splitAt and indexing in O(log n), sharing
+// subtrees between lists. Suits lists that are appended to from either
+// side, such as a Writer log built up by left-nested binds.
+struct FingerStorage {
+  template <typename T> using Container = impl::FingerTree<T>;
+  template <typename T>
+  using Builder = typename impl::FingerTree<T>::Builder;
+
+  template <typename C> static C tail(const C &xs) { return xs.tail(); }
+  template <typename C> static C init(const C &xs) { return xs.init(); }
+
+  template <typename C, typename T> static C cons(T &&x, const C &xs) {
+    C result = xs;
+    result.push_front(std::forward<T>(x));
+    return result;
+  }
+
+  template <typename C, typename T> static C snoc(const C &xs, T &&x) {
+    C result = xs;
+    result.push_back(std::forward<T>(x));
+    return result;
+  }
+
+  template <typename C> static C concat(const C &xs, const C &ys) {
+    return C::concat(xs, ys);
+  }
+
+  template <typename C>
+  static std::pair<C, C> splitAt(const C &xs, std::size_t n) {
+    return xs.splitAt(n);
+  }
+
+  template <typename C>
+  static const typename C::value_type &index(const C &xs, std::size_t i) {
+    return xs[i];
+  }
+};
+
+} // namespace caskell
+
+#endif // CASKELL_LIST_STORAGE_HPP
@@ -0,0 +1,183 @@
+#pragma once
+#ifndef CASKELL_MAPPED_FILE_HPP
+#define CASKELL_MAPPED_FILE_HPP
+
+// Zero-copy LazyStream source over a memory-mapped file (POSIX only).
+#if __has_include(<sys/mman.h>)
+
+#include "lazystream.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace caskell {
+
+class MappedFileGenerator;
+
+// Read-only mapping of a whole file, unmapped on destruction. Records
+// produced by its generators are views into the mapping and stay valid for
+// the lifetime of the MappedFile.
+class MappedFile {
+  const char *data_ = nullptr;
+  std::size_t size_ = 0;
+
+  // Callers pass errno saved before close(), which may overwrite it.
+  [[noreturn]] static void fail(int error, const std::string &what,
+                                const std::string &path) {
+    throw std::system_error(error, std::generic_category(),
+                            "caskell: cannot " + what + " " + path);
+  }
+
+public:
+  explicit MappedFile(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      fail(errno, "open", path);
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+      int error = errno;
+      ::close(fd);
+      fail(error, "stat", path);
+    }
+    size_ = static_cast<std::size_t>(info.st_size);
+    if (size_ != 0) {
+      void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        int error = errno;
+        ::close(fd);
+        fail(error, "map", path);
+      }
+      data_ = static_cast<const char *>(p);
+      ::madvise(p, size_, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() {
+    if (data_)
+      ::munmap(const_cast<char *>(data_), size_);
+  }
+
+  const char *data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+  // Newline-terminated lines, without the '\n'.
+  MappedFileGenerator lines() const;
+  // Fixed-size records; a trailing partial record is dropped.
+  MappedFileGenerator records(std::size_t recordSize) const;
+};
+
+namespace impl {
+template <> struct GeneratorTraits<MappedFileGenerator> {
+  using ValueType = std::string_view;
+  static constexpr bool IsBatchable = true;
+  static constexpr bool IsSplittable = true;
+};
+} // namespace impl
+
+// Yields the records of a MappedFile as std::string_views into the
+// mapping, without copying. Splitting works in source units, bytes for
+// lines and records for fixed-size records, and part boundaries are moved
+// forward to the next record start, so parallel consumers never see a torn
+// record.
+class MappedFileGenerator : public Generator<MappedFileGenerator> {
+  const MappedFile *file_;
+  std::size_t recordSize_; // 0 for newline-delimited lines
+  mutable std::size_t pos_;
+  std::size_t end_;
+
+  friend class MappedFile;
+
+  MappedFileGenerator(const MappedFile &file, std::size_t recordSize)
+      : file_(&file), recordSize_(recordSize), pos_(0), end_(file.size()) {
+    if (recordSize_ != 0)
+      end_ -= end_ % recordSize_;
+  }
+
+  const char *data() const { return file_->data(); }
+
+  // First record start at or after p.
+  std::size_t alignForward(std::size_t p) const {
+    if (p <= pos_)
+      return pos_;
+    if (p >= end_)
+      return end_;
+    if (data()[p - 1] == '\n')
+      return p;
+    auto *newline
+        = static_cast<const char *>(std::memchr(data() + p, '\n', end_ - p));
+    return newline ? newline - data() + 1 : end_;
+  }
+
+public:
+  using ValueType = std::string_view;
+
+  std::optional<std::string_view> nextImpl() const {
+    if (pos_ == end_)
+      return std::nullopt;
+    if (recordSize_ != 0) {
+      std::string_view record(data() + pos_, recordSize_);
+      pos_ += recordSize_;
+      return record;
+    }
+    auto *begin = data() + pos_;
+    auto *newline
+        = static_cast<const char *>(std::memchr(begin, '\n', end_ - pos_));
+    std::size_t length = newline ? newline - begin : end_ - pos_;
+    pos_ += newline ? length + 1 : length;
+    return std::string_view(begin, length);
+  }
+
+  std::size_t nextBatchImpl(std::string_view *out, std::size_t n) const {
+    std::size_t i = 0;
+    for (; i < n && pos_ != end_; ++i)
+      out[i] = *nextImpl();
+    return i;
+  }
+
+  std::size_t splitSize() const {
+    return recordSize_ != 0 ? (end_ - pos_) / recordSize_ : end_ - pos_;
+  }
+
+  MappedFileGenerator slice(std::size_t begin, std::size_t len) const {
+    MappedFileGenerator part = *this;
+    if (recordSize_ != 0) {
+      part.pos_ = pos_ + begin * recordSize_;
+      part.end_ = part.pos_ + len * recordSize_;
+    } else {
+      part.pos_ = alignForward(pos_ + begin);
+      part.end_ = std::max(part.pos_, alignForward(pos_ + begin + len));
+    }
+    return part;
+  }
+};
+
+inline MappedFileGenerator MappedFile::lines() const {
+  return MappedFileGenerator(*this, 0);
+}
+
+inline MappedFileGenerator MappedFile::records(std::size_t recordSize) const {
+  if (recordSize == 0)
+    throw std::invalid_argument("caskell: record size must be positive");
+  return MappedFileGenerator(*this, recordSize);
+}
+
+} // namespace caskell
+
+#endif // __has_include(<sys/mman.h>)
+
+#endif // CASKELL_MAPPED_FILE_HPP
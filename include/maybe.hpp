@@ -3,6 +3,8 @@
 #define CASKELL_MAYBE_HPP
 
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <optional>
 #include <ostream>
 #include <type_traits>
@@ -10,10 +12,108 @@
 
 namespace caskell {
 
-// Maybe type implementation
+// Customization point for the layout of Maybe<T>. A specialization with
+// HasNiche names a value of T that no Just ever holds; Maybe<T> then
+// stores Nothing as that value, so it is no larger than T and isJust() is
+// a comparison:
+//
+//   template <> struct caskell::MaybeTraits<Handle> {
+//     static constexpr bool HasNiche = true;
+//     static Handle nothing() { return Handle{-1}; }
+//     static bool isNothing(const Handle &h) { return h.fd == -1; }
+//   };
+//
+// Without one, Maybe<T> keeps a std::optional<T>.
+template <typename T, typename = void> struct MaybeTraits {
+  static constexpr bool HasNiche = false;
+};
+
+// Traits for an integral or enum T whose Nothing is Sentinel, e.g.
+//   template <> struct caskell::MaybeTraits<Port>
+//       : caskell::MaybeSentinel<Port, Port::None> {};
+template <typename T, T Sentinel> struct MaybeSentinel {
+  static constexpr bool HasNiche = true;
+  static constexpr T nothing() { return Sentinel; }
+  static constexpr bool isNothing(const T &x) { return x == Sentinel; }
+};
+
+// Pointers: Nothing is the all-ones address, where no object can start.
+// It is not nullptr, so Just(nullptr) stays a Just, as with std::optional.
+template <typename T>
+struct MaybeTraits<T, std::enable_if_t<std::is_pointer_v<T>>> {
+  static constexpr bool HasNiche = true;
+
+  static T nothing() { return reinterpret_cast<T>(~std::uintptr_t(0)); }
+  static bool isNothing(const T &x) {
+    return reinterpret_cast<std::uintptr_t>(x) == ~std::uintptr_t(0);
+  }
+};
+
+// float and double: Nothing is one NaN bit pattern that arithmetic does not
+// produce; every other NaN, like every other value, is a Just. The bits
+// are compared, not the values.
+template <typename T>
+struct MaybeTraits<T, std::enable_if_t<std::is_same_v<T, float>
+                                       || std::is_same_v<T, double>>> {
+  using Bits = std::conditional_t<sizeof(T) == 4, std::uint32_t,
+                                  std::uint64_t>;
+  static constexpr Bits NothingBits = sizeof(T) == 4
+                                          ? Bits(0x7fc00badu)
+                                          : Bits(0x7ff8000000000badull);
+
+  static constexpr bool HasNiche = true;
+
+  static T nothing() {
+    T x;
+    std::memcpy(&x, &NothingBits, sizeof x);
+    return x;
+  }
+
+  static bool isNothing(const T &x) {
+    Bits bits;
+    std::memcpy(&bits, &x, sizeof bits);
+    return bits == NothingBits;
+  }
+};
+
+namespace impl {
+
+template <typename T, bool Niche = MaybeTraits<T>::HasNiche>
+class MaybeStorage {
+  std::optional<T> value_;
+
+public:
+  MaybeStorage() = default;
+  explicit MaybeStorage(T value) : value_(std::move(value)) {}
+
+  bool has() const { return value_.has_value(); }
+  const T &get() const { return *value_; }
+  T &get() { return *value_; }
+};
+
+template <typename T> class MaybeStorage<T, true> {
+  using Traits = MaybeTraits<T>;
+
+  T value_ = Traits::nothing();
+
+public:
+  MaybeStorage() = default;
+  explicit MaybeStorage(T value) : value_(std::move(value)) {
+    assert(!Traits::isNothing(value_)
+           && "a Just cannot hold the niche value of MaybeTraits<T>");
+  }
+
+  bool has() const { return !Traits::isNothing(value_); }
+  const T &get() const { return value_; }
+  T &get() { return value_; }
+};
+
+} // namespace impl
+
+// Maybe type implementation. See MaybeTraits for the layout.
 template <typename T> class Maybe {
 private:
-  std::optional<T> value;
+  impl::MaybeStorage<T> value;
 
 public:
   using value_type = T;
@@ -23,70 +123,123 @@ public:
   explicit Maybe(T value) : value(std::move(value)) {}
 
   // Check if Maybe contains a value
-  bool isJust() const { return value.has_value(); }
-  bool isNothing() const { return !value.has_value(); }
+  bool isJust() const { return value.has(); }
+  bool isNothing() const { return !value.has(); }
 
-  // Safe value access
-  const T &operator*() const { return *value; }
-  T &operator*() { return *value; }
+  // Safe value access. Writing the niche value of MaybeTraits<T> through
+  // the mutable overload turns the Maybe into Nothing, unchecked.
+  const T &operator*() const { return value.get(); }
+  T &operator*() { return value.get(); }
 
-  // Map operation (fmap)
+  // Map operation (fmap). On an rvalue the value is moved into f, and a
+  // result of the same type reuses this Maybe.
   template <typename F, typename = std::enable_if_t<std::is_invocable_v<F, T>>>
-  auto map(F &&f) const {
+  auto map(F &&f) const & {
     if (!isJust()) {
       return Maybe<std::invoke_result_t<F, T>>();
     }
-    return Maybe<std::invoke_result_t<F, T>>(std::forward<F>(f)(*value));
+    return Maybe<std::invoke_result_t<F, T>>(std::forward<F>(f)(**this));
+  }
+
+  template <typename F, typename = std::enable_if_t<std::is_invocable_v<F, T>>>
+  auto map(F &&f) && {
+    using R = std::invoke_result_t<F, T>;
+    if constexpr (std::is_same_v<R, T>) {
+      // Through the storage constructor, which rejects the niche value.
+      if (isJust())
+        value = impl::MaybeStorage<T>(std::forward<F>(f)(std::move(**this)));
+      return std::move(*this);
+    } else {
+      if (!isJust()) {
+        return Maybe<R>();
+      }
+      return Maybe<R>(std::forward<F>(f)(std::move(**this)));
+    }
   }
 
   // Bind operation (>>=)
   template <typename F, typename Result = std::invoke_result_t<F, T>,
             typename = std::enable_if_t<
                 std::is_same_v<Result, Maybe<typename Result::value_type>>>>
-  Result and_then(F &&f) const {
+  Result and_then(F &&f) const & {
+    if (!isJust()) {
+      return Result();
+    }
+    return std::forward<F>(f)(**this);
+  }
+
+  template <typename F, typename Result = std::invoke_result_t<F, T>,
+            typename = std::enable_if_t<
+                std::is_same_v<Result, Maybe<typename Result::value_type>>>>
+  Result and_then(F &&f) && {
     if (!isJust()) {
       return Result();
     }
-    return std::forward<F>(f)(*value);
+    return std::forward<F>(f)(std::move(**this));
   }
 
   // Value or default
-  template <typename U> T value_or(U &&default_value) const {
-    return value.value_or(std::forward<U>(default_value));
+  template <typename U> T value_or(U &&default_value) const & {
+    return isJust() ? **this : static_cast<T>(std::forward<U>(default_value));
+  }
+
+  template <typename U> T value_or(U &&default_value) && {
+    return isJust() ? std::move(**this)
+                    : static_cast<T>(std::forward<U>(default_value));
   }
 
   // Operator overloads
   template <typename F, typename = std::enable_if_t<std::is_invocable_v<F, T>>>
-  auto operator>>(F &&f) const {
+  auto operator>>(F &&f) const & {
     return map(std::forward<F>(f));
   }
 
+  template <typename F, typename = std::enable_if_t<std::is_invocable_v<F, T>>>
+  auto operator>>(F &&f) && {
+    return std::move(*this).map(std::forward<F>(f));
+  }
+
   template <typename F, typename Result = std::invoke_result_t<F, T>,
             typename = std::enable_if_t<
                 std::is_same_v<Result, Maybe<typename Result::value_type>>>>
-  Result operator>>=(F &&f) const {
+  Result operator>>=(F &&f) const & {
     return and_then(std::forward<F>(f));
   }
 
+  template <typename F, typename Result = std::invoke_result_t<F, T>,
+            typename = std::enable_if_t<
+                std::is_same_v<Result, Maybe<typename Result::value_type>>>>
+  Result operator>>=(F &&f) && {
+    return std::move(*this).and_then(std::forward<F>(f));
+  }
+
+  template <typename F, typename = std::enable_if_t<std::is_invocable_v<F, T>>>
+  auto operator|(F &&f) const & {
+    if (!isJust()) {
+      return std::invoke_result_t<F, T>();
+    }
+    return std::forward<F>(f)(**this);
+  }
+
   template <typename F, typename = std::enable_if_t<std::is_invocable_v<F, T>>>
-  auto operator|(F &&f) const {
+  auto operator|(F &&f) && {
     if (!isJust()) {
       return std::invoke_result_t<F, T>();
     }
-    return std::forward<F>(f)(*value);
+    return std::forward<F>(f)(std::move(**this));
   }
 
   friend bool operator==(const Maybe &a, const Maybe &b) {
-    if (a.value.has_value() != b.value.has_value())
+    if (a.isJust() != b.isJust())
       return false;
-    if (!a.value.has_value())
+    if (!a.isJust())
       return true;
-    return a.value.value() == b.value.value();
+    return *a == *b;
   }
 
   friend std::ostream &operator<<(std::ostream &os, const Maybe &m) {
-    if (m.value.has_value())
-      return os << "Just(" << m.value.value() << ")";
+    if (m.isJust())
+      return os << "Just(" << *m << ")";
     return os << "Nothing";
   }
 };
@@ -0,0 +1,145 @@
+#pragma once
+#ifndef CASKELL_PARALLEL_HPP
+#define CASKELL_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace caskell {
+namespace impl {
+
+// Smallest number of elements worth handing to a separate worker.
+inline constexpr std::size_t ParallelGrain = 4096;
+
+// Process-wide pool of worker threads shared by all parallel operations.
+// The calling thread always takes part in its own job, so nested parallel
+// calls make progress even when every worker is busy.
+class ThreadPool {
+  struct Job {
+    std::function<void(std::size_t)> task;
+    std::size_t count = 0;
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr error;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<std::shared_ptr<Job>> queue_;
+  std::vector<std::thread> workers_;
+  bool stopping_ = false;
+
+  static void work(Job &job) {
+    for (std::size_t i; (i = job.next.fetch_add(1)) < job.count;) {
+      try {
+        job.task(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (!job.error)
+          job.error = std::current_exception();
+      }
+      if (job.done.fetch_add(1) + 1 == job.count) {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.finished.notify_all();
+      }
+    }
+  }
+
+  void loop() {
+    for (;;) {
+      std::shared_ptr<Job> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty())
+          return;
+        job = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      work(*job);
+    }
+  }
+
+public:
+  explicit ThreadPool(std::size_t threads) {
+    for (std::size_t i = 0; i < threads; ++i)
+      workers_.emplace_back([this] { loop(); });
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto &worker : workers_)
+      worker.join();
+  }
+
+  static ThreadPool &instance() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency())
+                           - 1);
+    return pool;
+  }
+
+  // Number of threads that can run tasks concurrently, including the caller.
+  std::size_t concurrency() const { return workers_.size() + 1; }
+
+  // Runs task(i) for every i in [0, count) and blocks until all are done.
+  // The first exception thrown by a task is rethrown here.
+  template <typename Task> void run(std::size_t count, Task &&task) {
+    if (count <= 1 || workers_.empty()) {
+      for (std::size_t i = 0; i < count; ++i)
+        task(i);
+      return;
+    }
+    auto job = std::make_shared<Job>();
+    job->task = [&task](std::size_t i) { task(i); };
+    job->count = count;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (std::size_t i = 0, helpers = std::min(count - 1, workers_.size());
+           i < helpers; ++i)
+        queue_.push_back(job);
+    }
+    ready_.notify_all();
+    work(*job);
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job] { return job->done == job->count; });
+    if (job->error)
+      std::rethrow_exception(job->error);
+  }
+};
+
+inline std::size_t parallelism() {
+  return ThreadPool::instance().concurrency();
+}
+
+// Number of contiguous parts to split size elements into.
+inline std::size_t partitionCount(std::size_t size) {
+  return std::max<std::size_t>(
+      1, std::min(parallelism(), size / ParallelGrain));
+}
+
+template <typename Task> void parallelFor(std::size_t count, Task &&task) {
+  ThreadPool::instance().run(count, std::forward<Task>(task));
+}
+
+} // namespace impl
+} // namespace caskell
+
+#endif // CASKELL_PARALLEL_HPP
@@ -0,0 +1,249 @@
+#pragma once
+#ifndef CASKELL_SHOW_HPP
+#define CASKELL_SHOW_HPP
+
+#include "maybe.hpp"
+#include "variant.hpp"
+#include <charconv>
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace caskell {
+
+// Show typeclass. A specialization defines show(x), and may also define
+// showTo(x, out), which appends the text to out (a string or an ostream)
+// instead of returning it, and shownSize(x), the length of that text or
+// an estimate. Composite instances write their parts through showTo into
+// one buffer, sized up front when every part has shownSize, rather than
+// concatenating a string per element.
+template <typename T> struct Show {
+  static std::string show(const T &x);
+};
+
+namespace impl {
+
+template <typename T, typename = void>
+struct HasMember_showTo : std::false_type {};
+
+template <typename T>
+struct HasMember_showTo<
+    T, std::void_t<decltype(Show<T>::showTo(std::declval<const T &>(),
+                                            std::declval<std::string &>()))>>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct HasMember_shownSize : std::false_type {};
+
+template <typename T>
+struct HasMember_shownSize<
+    T, std::void_t<decltype(Show<T>::shownSize(std::declval<const T &>()))>>
+    : std::true_type {};
+
+template <typename Out> void write(Out &out, std::string_view text) {
+  if constexpr (std::is_base_of_v<std::ostream, Out>) {
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+  } else {
+    out.append(text.data(), text.size());
+  }
+}
+
+template <typename Out> void write(Out &out, char c) {
+  if constexpr (std::is_base_of_v<std::ostream, Out>) {
+    out.put(c);
+  } else {
+    out.push_back(c);
+  }
+}
+
+// Appends Show<T> of x to out, through show() if there is no showTo().
+template <typename T, typename Out> void showInto(const T &x, Out &out) {
+  if constexpr (HasMember_showTo<T>::value) {
+    Show<T>::showTo(x, out);
+  } else {
+    std::string text = Show<T>::show(x);
+    write(out, text);
+  }
+}
+
+template <typename T> std::size_t shownSize(const T &x) {
+  if constexpr (HasMember_shownSize<T>::value) {
+    return Show<T>::shownSize(x);
+  } else {
+    return 0;
+  }
+}
+
+// show() of the instances that define showTo().
+template <typename T> std::string showString(const T &x) {
+  std::string result;
+  result.reserve(shownSize(x));
+  Show<T>::showTo(x, result);
+  return result;
+}
+
+template <typename Int> struct ShowInteger {
+  template <typename Out> static void showTo(const Int &x, Out &out) {
+    char buffer[std::numeric_limits<Int>::digits10 + 2];
+    char *end = std::to_chars(buffer, buffer + sizeof buffer, x).ptr;
+    write(out, std::string_view(buffer, end - buffer));
+  }
+
+  static std::size_t shownSize(const Int &x) {
+    std::size_t size = 1;
+    if constexpr (std::is_signed_v<Int>) {
+      size += x < 0;
+    }
+    for (Int rest = x / 10; rest != 0; rest /= 10)
+      ++size;
+    return size;
+  }
+
+  static std::string show(const Int &x) { return showString(x); }
+};
+
+// Fixed notation with six decimals, as std::to_string prints.
+template <typename Float> struct ShowFloat {
+  template <typename Out> static void showTo(const Float &x, Out &out) {
+    char buffer[std::numeric_limits<Float>::max_exponent10 + 10];
+    char *end = std::to_chars(buffer, buffer + sizeof buffer, x,
+                              std::chars_format::fixed, 6)
+                    .ptr;
+    write(out, std::string_view(buffer, end - buffer));
+  }
+
+  static std::string show(const Float &x) { return showString(x); }
+};
+
+template <typename... Ts>
+inline constexpr bool AllSized = (HasMember_shownSize<Ts>::value && ...);
+
+} // namespace impl
+
+// Appends the Show representation of x to out, a string or an ostream,
+// and returns out: the ShowS of Haskell.
+template <typename T, typename Out> Out &showTo(const T &x, Out &out) {
+  impl::showInto(x, out);
+  return out;
+}
+
+template <> struct Show<int> : impl::ShowInteger<int> {};
+template <> struct Show<long> : impl::ShowInteger<long> {};
+template <> struct Show<long long> : impl::ShowInteger<long long> {};
+template <> struct Show<unsigned int> : impl::ShowInteger<unsigned int> {};
+template <> struct Show<unsigned long> : impl::ShowInteger<unsigned long> {};
+template <>
+struct Show<unsigned long long> : impl::ShowInteger<unsigned long long> {};
+
+template <> struct Show<float> : impl::ShowFloat<float> {};
+template <> struct Show<double> : impl::ShowFloat<double> {};
+
+template <> struct Show<std::string> {
+  template <typename Out> static void showTo(const std::string &x, Out &out) {
+    impl::write(out, '"');
+    impl::write(out, x);
+    impl::write(out, '"');
+  }
+
+  static std::size_t shownSize(const std::string &x) { return x.size() + 2; }
+
+  static std::string show(const std::string &x) {
+    return impl::showString(x);
+  }
+};
+
+template <typename T> struct Show<Maybe<T>> {
+  template <typename Out> static void showTo(const Maybe<T> &x, Out &out) {
+    if (!x.isJust()) {
+      impl::write(out, "Nothing");
+      return;
+    }
+    impl::write(out, "Just(");
+    impl::showInto(*x, out);
+    impl::write(out, ')');
+  }
+
+  static std::size_t shownSize(const Maybe<T> &x) {
+    return x.isJust() ? impl::shownSize(*x) + 6 : 7;
+  }
+
+  static std::string show(const Maybe<T> &x) { return impl::showString(x); }
+};
+
+// Tuples and pairs as (a, b, ...).
+template <typename... Ts> struct Show<std::tuple<Ts...>> {
+  template <typename Out>
+  static void showTo(const std::tuple<Ts...> &xs, Out &out) {
+    impl::write(out, '(');
+    bool first = true;
+    auto item = [&](const auto &x) {
+      if (!first)
+        impl::write(out, ", ");
+      first = false;
+      impl::showInto(x, out);
+    };
+    std::apply([&item](const auto &...x) { (item(x), ...); }, xs);
+    impl::write(out, ')');
+  }
+
+  template <bool Sized = impl::AllSized<Ts...>,
+            typename = std::enable_if_t<Sized>>
+  static std::size_t shownSize(const std::tuple<Ts...> &xs) {
+    std::size_t size = sizeof...(Ts) > 0 ? 2 * sizeof...(Ts) : 2;
+    return std::apply(
+        [size](const auto &...x) { return (size + ... + impl::shownSize(x)); },
+        xs);
+  }
+
+  static std::string show(const std::tuple<Ts...> &xs) {
+    return impl::showString(xs);
+  }
+};
+
+template <typename A, typename B> struct Show<std::pair<A, B>> {
+  template <typename Out>
+  static void showTo(const std::pair<A, B> &x, Out &out) {
+    impl::write(out, '(');
+    impl::showInto(x.first, out);
+    impl::write(out, ", ");
+    impl::showInto(x.second, out);
+    impl::write(out, ')');
+  }
+
+  template <bool Sized = impl::AllSized<A, B>,
+            typename = std::enable_if_t<Sized>>
+  static std::size_t shownSize(const std::pair<A, B> &x) {
+    return impl::shownSize(x.first) + impl::shownSize(x.second) + 4;
+  }
+
+  static std::string show(const std::pair<A, B> &x) {
+    return impl::showString(x);
+  }
+};
+
+// The held alternative, shown as itself.
+template <typename... Ts> struct Show<Variant<Ts...>> {
+  template <typename Out>
+  static void showTo(const Variant<Ts...> &x, Out &out) {
+    x.visit([&out](const auto &value) { impl::showInto(value, out); });
+  }
+
+  template <bool Sized = impl::AllSized<Ts...>,
+            typename = std::enable_if_t<Sized>>
+  static std::size_t shownSize(const Variant<Ts...> &x) {
+    return x.visit([](const auto &value) { return impl::shownSize(value); });
+  }
+
+  static std::string show(const Variant<Ts...> &x) {
+    return impl::showString(x);
+  }
+};
+
+} // namespace caskell
+
+#endif // CASKELL_SHOW_HPP
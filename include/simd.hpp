@@ -0,0 +1,497 @@
+#pragma once
+#ifndef CASKELL_SIMD_HPP
+#define CASKELL_SIMD_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Vector kernels are written with GCC vector extensions; other compilers
+// only get the scalar loops.
+#if defined(__GNUC__)
+#define CASKELL_SIMD_VECTORS 1
+#define CASKELL_SIMD_INLINE inline __attribute__((always_inline))
+#else
+#define CASKELL_SIMD_VECTORS 0
+#define CASKELL_SIMD_INLINE inline
+#endif
+
+#if CASKELL_SIMD_VECTORS && (defined(__x86_64__) || defined(__i386__))
+#define CASKELL_SIMD_X86 1
+#else
+#define CASKELL_SIMD_X86 0
+#endif
+
+namespace caskell {
+
+// Reductions that Stream::reduce and LazyStream::reduce can hand to vector
+// kernels. Each is also an ordinary binary function, so wherever no kernel
+// applies the reduction is the usual left fold.
+namespace ops {
+struct Sum {
+  template <typename A, typename T>
+  constexpr A operator()(const A &acc, const T &x) const {
+    return acc + x;
+  }
+};
+
+struct Min {
+  template <typename A, typename T>
+  constexpr A operator()(const A &acc, const T &x) const {
+    return x < acc ? A(x) : acc;
+  }
+};
+
+struct Max {
+  template <typename A, typename T>
+  constexpr A operator()(const A &acc, const T &x) const {
+    return acc < x ? A(x) : acc;
+  }
+};
+
+// Counts the elements x for which cmp(x, bound) holds. Kernels exist for
+// the standard comparison functors.
+template <typename Cmp, typename T> struct CountIf {
+  Cmp cmp;
+  T bound;
+
+  template <typename A, typename X>
+  constexpr A operator()(const A &acc, const X &x) const {
+    return cmp(x, bound) ? acc + 1 : acc;
+  }
+};
+
+template <typename Cmp, typename T>
+constexpr CountIf<Cmp, T> countIf(Cmp cmp, T bound) {
+  return {std::move(cmp), std::move(bound)};
+}
+
+// Sum of products over pairs, such as the elements of a zipped stream.
+struct Dot {
+  template <typename A, typename P>
+  constexpr A operator()(const A &acc, const P &pair) const {
+    return acc + std::get<0>(pair) * std::get<1>(pair);
+  }
+};
+
+inline constexpr Sum sum{};
+inline constexpr Min min{};
+inline constexpr Max max{};
+inline constexpr Dot dot{};
+} // namespace ops
+
+// Opts a reduction into evaluation in any order. Kernels then keep several
+// partial results per vector lane, so floating-point sums and dot products
+// may round differently from the left fold, and min/max may pick a
+// different NaN. Integer reductions never need this wrapper.
+template <typename Op> struct Reassociate {
+  Op op;
+
+  template <typename... Args>
+  constexpr decltype(auto) operator()(Args &&...args) const {
+    return op(std::forward<Args>(args)...);
+  }
+};
+
+template <typename Op> constexpr Reassociate<Op> reassociate(Op op) {
+  return {std::move(op)};
+}
+
+namespace impl {
+namespace simd {
+
+// Dot names the two-input kernel behind caskell::dot(); it is not a kind
+// of Reduction, since a fold sees one element at a time.
+enum class Kind { None, Sum, Min, Max, CountIf, Dot };
+enum class Compare { Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual };
+enum class Isa { Scalar, SSE2, AVX2, AVX512 };
+
+template <typename Cmp> struct CompareOf {
+  static constexpr bool known = false;
+};
+
+#define CASKELL_SIMD_COMPARE(Functor, Value)                                  \
+  template <typename T> struct CompareOf<std::Functor<T>> {                   \
+    static constexpr bool known = true;                                        \
+    static constexpr Compare value = Compare::Value;                           \
+  };
+CASKELL_SIMD_COMPARE(less, Less)
+CASKELL_SIMD_COMPARE(less_equal, LessEqual)
+CASKELL_SIMD_COMPARE(greater, Greater)
+CASKELL_SIMD_COMPARE(greater_equal, GreaterEqual)
+CASKELL_SIMD_COMPARE(equal_to, Equal)
+CASKELL_SIMD_COMPARE(not_equal_to, NotEqual)
+#undef CASKELL_SIMD_COMPARE
+
+// What a reduction functor computes, as far as the kernels are concerned.
+template <typename Op> struct Reduction {
+  static constexpr Kind kind = Kind::None;
+  static constexpr bool reassociable = false;
+  static const Op &base(const Op &op) { return op; }
+};
+
+template <Kind K> struct ReductionOf {
+  static constexpr Kind kind = K;
+  static constexpr bool reassociable = false;
+  template <typename Op> static const Op &base(const Op &op) { return op; }
+};
+
+template <> struct Reduction<ops::Sum> : ReductionOf<Kind::Sum> {};
+template <typename T>
+struct Reduction<std::plus<T>> : ReductionOf<Kind::Sum> {};
+template <> struct Reduction<ops::Min> : ReductionOf<Kind::Min> {};
+template <> struct Reduction<ops::Max> : ReductionOf<Kind::Max> {};
+
+template <typename Cmp, typename T>
+struct Reduction<ops::CountIf<Cmp, T>>
+    : ReductionOf<CompareOf<Cmp>::known ? Kind::CountIf : Kind::None> {};
+
+template <typename Op> struct Reduction<Reassociate<Op>> : Reduction<Op> {
+  static constexpr bool reassociable = true;
+  static decltype(auto) base(const Reassociate<Op> &wrapped) {
+    return Reduction<Op>::base(wrapped.op);
+  }
+};
+
+// Element types the kernels handle: arithmetic types that fit a lane.
+template <typename T>
+inline constexpr bool IsLane = std::is_arithmetic_v<T>
+                               && !std::is_same_v<T, bool> && sizeof(T) <= 8;
+
+// False when Op converts its operands to a type other than the element
+// type T, as std::plus<int> does to long elements; the kernels would then
+// compute in T what the fold computes in the narrower type.
+template <typename Op, typename T> struct FoldsIn : std::true_type {};
+
+template <typename U, typename T>
+struct FoldsIn<std::plus<U>, T>
+    : std::bool_constant<std::is_same_v<U, T> || std::is_void_v<U>> {};
+
+template <typename Op, typename T>
+struct FoldsIn<Reassociate<Op>, T> : FoldsIn<Op, T> {};
+
+template <typename Op, typename A, typename T, typename = void>
+struct CountBound : std::false_type {};
+
+template <typename Cmp, typename B, typename A, typename T>
+struct CountBound<ops::CountIf<Cmp, B>, A, T>
+    : std::bool_constant<std::is_same_v<B, T> && std::is_arithmetic_v<A>> {};
+
+template <typename Op, typename A, typename T>
+struct CountBound<Reassociate<Op>, A, T> : CountBound<Op, A, T> {};
+
+// True when folding T elements into an A accumulator with Op may use a
+// kernel. Sum, min and max keep the accumulator type, so their result
+// cannot overflow differently; on floating point they need Reassociate.
+// Counting is exact in any order.
+template <typename Op, typename A, typename T>
+inline constexpr bool Vectorizable = [] {
+  using R = Reduction<Op>;
+  if constexpr (!IsLane<T>) {
+    return false;
+  } else if constexpr (R::kind == Kind::Sum || R::kind == Kind::Min
+                       || R::kind == Kind::Max) {
+    return std::is_same_v<A, T> && FoldsIn<Op, T>::value
+           && (std::is_integral_v<T> || R::reassociable);
+  } else if constexpr (R::kind == Kind::CountIf) {
+    return CountBound<Op, A, T>::value;
+  } else {
+    return false;
+  }
+}();
+
+template <Kind K, typename T>
+using KernelResult = std::conditional_t<K == Kind::CountIf, std::size_t, T>;
+
+// Scalar kernels. Min and max expect n > 0.
+template <Kind K, Compare C, typename T>
+KernelResult<K, T> scalarKernel(const T *a, const T *b, std::size_t n,
+                                T bound) {
+  if constexpr (K == Kind::Sum || K == Kind::Dot) {
+    T total = T();
+    for (std::size_t i = 0; i < n; ++i) {
+      if constexpr (K == Kind::Dot) {
+        total += a[i] * b[i];
+      } else {
+        total += a[i];
+      }
+    }
+    return total;
+  } else if constexpr (K == Kind::Min || K == Kind::Max) {
+    T best = a[0];
+    for (std::size_t i = 1; i < n; ++i)
+      best = K == Kind::Min ? ops::Min()(best, a[i]) : ops::Max()(best, a[i]);
+    return best;
+  } else {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      if constexpr (C == Compare::Less) {
+        count += a[i] < bound;
+      } else if constexpr (C == Compare::LessEqual) {
+        count += a[i] <= bound;
+      } else if constexpr (C == Compare::Greater) {
+        count += a[i] > bound;
+      } else if constexpr (C == Compare::GreaterEqual) {
+        count += a[i] >= bound;
+      } else if constexpr (C == Compare::Equal) {
+        count += a[i] == bound;
+      } else {
+        count += a[i] != bound;
+      }
+    }
+    return count;
+  }
+}
+
+#if CASKELL_SIMD_VECTORS
+// Lane type of the mask a vector comparison yields for Size-byte elements.
+template <std::size_t Size> struct MaskLane;
+template <> struct MaskLane<1> {
+  using type = std::int8_t;
+};
+template <> struct MaskLane<2> {
+  using type = std::int16_t;
+};
+template <> struct MaskLane<4> {
+  using type = std::int32_t;
+};
+template <> struct MaskLane<8> {
+  using type = std::int64_t;
+};
+
+// Generic kernel over Bytes-wide vectors. It is always inlined into the
+// per-ISA entry points below, which is where the instruction set is
+// chosen. Sums keep four independent accumulators to hide add latency.
+template <std::size_t Bytes, Kind K, Compare C, typename T>
+CASKELL_SIMD_INLINE KernelResult<K, T>
+vectorKernel(const T *a, const T *b, std::size_t n, T bound) {
+  typedef T V __attribute__((vector_size(Bytes)));
+  constexpr std::size_t Lanes = Bytes / sizeof(T);
+  if (n < 4 * Lanes)
+    return scalarKernel<K, C>(a, b, n, bound);
+
+  std::size_t i = 0;
+  if constexpr (K == Kind::Sum || K == Kind::Dot) {
+    V acc[4] = {};
+    for (; i + 4 * Lanes <= n; i += 4 * Lanes) {
+      for (std::size_t k = 0; k < 4; ++k) {
+        V x;
+        std::memcpy(&x, a + i + k * Lanes, sizeof x);
+        if constexpr (K == Kind::Dot) {
+          V y;
+          std::memcpy(&y, b + i + k * Lanes, sizeof y);
+          x *= y;
+        }
+        acc[k] += x;
+      }
+    }
+    V folded = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    T total = T();
+    for (std::size_t lane = 0; lane < Lanes; ++lane)
+      total += folded[lane];
+    return T(total + scalarKernel<K, C>(a + i, b + i, n - i, bound));
+  } else if constexpr (K == Kind::Min || K == Kind::Max) {
+    V best;
+    std::memcpy(&best, a, sizeof best);
+    for (i = Lanes; i + Lanes <= n; i += Lanes) {
+      V x;
+      std::memcpy(&x, a + i, sizeof x);
+      if constexpr (K == Kind::Min) {
+        best = x < best ? x : best;
+      } else {
+        best = best < x ? x : best;
+      }
+    }
+    T result = best[0];
+    for (std::size_t lane = 1; lane < Lanes; ++lane)
+      result = K == Kind::Min ? ops::Min()(result, T(best[lane]))
+                              : ops::Max()(result, T(best[lane]));
+    for (; i < n; ++i)
+      result = K == Kind::Min ? ops::Min()(result, a[i])
+                              : ops::Max()(result, a[i]);
+    return result;
+  } else {
+    // Comparisons yield -1 per matching lane. Lane counters are flushed
+    // before they can overflow, which matters for 8- and 16-bit types.
+    using Mask = decltype(V{} < V{});
+    constexpr std::size_t Flush = std::min<std::size_t>(
+        std::numeric_limits<typename MaskLane<sizeof(T)>::type>::max(),
+        std::size_t(1) << 20);
+    V limit = V{} + bound;
+    std::size_t count = 0;
+    while (i + Lanes <= n) {
+      Mask hits = {};
+      std::size_t stop = std::min(n - (n - i) % Lanes, i + Flush * Lanes);
+      for (; i < stop; i += Lanes) {
+        V x;
+        std::memcpy(&x, a + i, sizeof x);
+        if constexpr (C == Compare::Less) {
+          hits -= x < limit;
+        } else if constexpr (C == Compare::LessEqual) {
+          hits -= x <= limit;
+        } else if constexpr (C == Compare::Greater) {
+          hits -= x > limit;
+        } else if constexpr (C == Compare::GreaterEqual) {
+          hits -= x >= limit;
+        } else if constexpr (C == Compare::Equal) {
+          hits -= x == limit;
+        } else {
+          hits -= x != limit;
+        }
+      }
+      for (std::size_t lane = 0; lane < Lanes; ++lane)
+        count += static_cast<std::size_t>(hits[lane]);
+    }
+    return count + scalarKernel<K, C>(a + i, b + i, n - i, bound);
+  }
+}
+#endif
+
+#if CASKELL_SIMD_X86
+template <Kind K, Compare C, typename T>
+__attribute__((target("avx2"))) KernelResult<K, T>
+avx2Kernel(const T *a, const T *b, std::size_t n, T bound) {
+  return vectorKernel<32, K, C>(a, b, n, bound);
+}
+
+template <Kind K, Compare C, typename T>
+__attribute__((target("avx512f,avx512bw"))) KernelResult<K, T>
+avx512Kernel(const T *a, const T *b, std::size_t n, T bound) {
+  return vectorKernel<64, K, C>(a, b, n, bound);
+}
+#endif
+
+inline Isa detectIsa() {
+#if CASKELL_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    return Isa::AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return Isa::AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return Isa::SSE2;
+  return Isa::Scalar;
+#elif CASKELL_SIMD_VECTORS
+  // 16-byte vectors map onto the baseline SIMD unit of other targets.
+  return Isa::SSE2;
+#else
+  return Isa::Scalar;
+#endif
+}
+
+// Widest instruction set the running CPU supports, detected once.
+inline Isa isa() {
+  static const Isa detected = detectIsa();
+  return detected;
+}
+
+// Runs kernel K over [a, a + n), and over [b, b + n) for Dot, on the given
+// instruction set. Min and max expect n > 0.
+template <typename T> struct NonDeduced {
+  using type = T;
+};
+
+template <Kind K, Compare C = Compare::Less, typename T>
+KernelResult<K, T> run(const T *a, const typename NonDeduced<T>::type *b,
+                       std::size_t n, typename NonDeduced<T>::type bound,
+                       Isa target = isa()) {
+  switch (target) {
+#if CASKELL_SIMD_X86
+  case Isa::AVX512:
+    return avx512Kernel<K, C>(a, b, n, bound);
+  case Isa::AVX2:
+    return avx2Kernel<K, C>(a, b, n, bound);
+#endif
+#if CASKELL_SIMD_VECTORS
+  case Isa::SSE2:
+    return vectorKernel<16, K, C>(a, b, n, bound);
+#endif
+  default:
+    return scalarKernel<K, C>(a, b, n, bound);
+  }
+}
+
+// Folds [data, data + n) into init with op. Only valid when
+// Vectorizable<Op, A, T> holds.
+template <typename Op, typename A, typename T>
+A reduce(const Op &op, A init, const T *data, std::size_t n) {
+  using R = Reduction<Op>;
+  if constexpr (R::kind == Kind::CountIf) {
+    const auto &count = R::base(op);
+    using Cmp = std::decay_t<decltype(count.cmp)>;
+    return init
+           + A(run<Kind::CountIf, CompareOf<Cmp>::value>(data, nullptr, n,
+                                                          count.bound));
+  } else {
+    if (n == 0)
+      return init;
+    return op(std::move(init), run<R::kind>(data, nullptr, n, T()));
+  }
+}
+
+// Buffers elements pushed one at a time and reduces each full block with a
+// kernel, for pipelines that produce their values on the fly.
+template <typename Op, typename A, typename T> class BlockReducer {
+  static constexpr std::size_t BlockSize = 256;
+
+  const Op &op_;
+  A acc_;
+  std::array<T, BlockSize> block_;
+  std::size_t count_ = 0;
+
+  void flush() {
+    acc_ = reduce(op_, std::move(acc_), block_.data(), count_);
+    count_ = 0;
+  }
+
+public:
+  BlockReducer(const Op &op, A init) : op_(op), acc_(std::move(init)) {}
+
+  void push(const T &item) {
+    block_[count_++] = item;
+    if (count_ == BlockSize)
+      flush();
+  }
+
+  A finish() {
+    flush();
+    return std::move(acc_);
+  }
+};
+
+} // namespace simd
+} // namespace impl
+
+// Inner product of two equally sized contiguous containers. Pass
+// reassociate(ops::dot) to let floating-point inputs use vector kernels.
+template <typename A, typename B, typename Op = ops::Dot>
+auto dot(const A &lhs, const B &rhs, const Op &op = Op()) {
+  using T = std::decay_t<decltype(*lhs.data())>;
+  static_assert(std::is_same_v<T, std::decay_t<decltype(*rhs.data())>>,
+                "dot() needs containers of the same element type");
+  constexpr bool reassociable = std::is_same_v<Op, Reassociate<ops::Dot>>;
+  static_assert(std::is_same_v<Op, ops::Dot> || reassociable,
+                "dot() takes ops::dot, optionally wrapped in reassociate()");
+  std::size_t n = std::min<std::size_t>(lhs.size(), rhs.size());
+  if constexpr (impl::simd::IsLane<T>
+                && (std::is_integral_v<T> || reassociable)) {
+    return impl::simd::run<impl::simd::Kind::Dot>(lhs.data(), rhs.data(), n,
+                                                   T());
+  } else {
+    T total = T();
+    for (std::size_t i = 0; i < n; ++i)
+      total = op(total, std::forward_as_tuple(lhs.data()[i], rhs.data()[i]));
+    return total;
+  }
+}
+
+} // namespace caskell
+
+#endif // CASKELL_SIMD_HPP
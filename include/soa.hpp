@@ -0,0 +1,377 @@
+#pragma once
+#ifndef CASKELL_SOA_HPP
+#define CASKELL_SOA_HPP
+
+#include "stream.hpp"
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace caskell {
+
+template <typename Record, auto... Members> class SoA;
+
+namespace impl {
+
+template <typename M> struct MemberOf;
+
+template <typename C, typename F> struct MemberOf<F C::*> {
+  using Class = C;
+  using Field = F;
+};
+
+template <auto A, auto B> struct SameMember : std::false_type {};
+template <auto A> struct SameMember<A, A> : std::true_type {};
+
+// Position of Member among Members, or sizeof...(Members) if absent.
+template <auto Member, auto... Members> struct MemberIndex;
+
+template <auto Member>
+struct MemberIndex<Member> : std::integral_constant<std::size_t, 0> {};
+
+template <auto Member, auto First, auto... Rest>
+struct MemberIndex<Member, First, Rest...>
+    : std::integral_constant<std::size_t,
+                             SameMember<Member, First>::value
+                                 ? 0
+                                 : 1 + MemberIndex<Member, Rest...>::value> {
+};
+
+// A row of an SoA container, standing in for a reference to a Record.
+// get<&Record::field>() reads one column; converting to Record gathers
+// every column. Assigning to a mutable row writes through to the columns.
+template <typename Owner, bool Const> class SoARow {
+  using OwnerPtr = std::conditional_t<Const, const Owner *, Owner *>;
+
+  OwnerPtr owner_;
+  std::size_t index_;
+
+public:
+  using Record = typename Owner::value_type;
+
+  SoARow(OwnerPtr owner, std::size_t index) : owner_(owner), index_(index) {}
+  SoARow(const SoARow &) = default;
+
+  template <bool C = Const, typename = std::enable_if_t<C>>
+  SoARow(const SoARow<Owner, false> &row)
+      : owner_(row.owner()), index_(row.index()) {}
+
+  OwnerPtr owner() const { return owner_; }
+  std::size_t index() const { return index_; }
+
+  template <auto Member> decltype(auto) get() const {
+    return owner_->template column<Member>()[index_];
+  }
+
+  operator Record() const { return owner_->gather(index_); }
+
+  template <bool C = Const, typename = std::enable_if_t<!C>>
+  const SoARow &operator=(const Record &record) const {
+    owner_->scatter(index_, record);
+    return *this;
+  }
+
+  template <bool C = Const, typename = std::enable_if_t<!C>>
+  const SoARow &operator=(Record &&record) const {
+    owner_->scatter(index_, std::move(record));
+    return *this;
+  }
+
+  const SoARow &operator=(const SoARow &row) const {
+    static_assert(!Const, "cannot assign through a const SoA row");
+    owner_->copyRow(index_, *row.owner_, row.index_);
+    return *this;
+  }
+
+  template <bool OtherConst, bool C = Const,
+            typename = std::enable_if_t<!C && OtherConst>>
+  const SoARow &operator=(const SoARow<Owner, OtherConst> &row) const {
+    owner_->copyRow(index_, *row.owner(), row.index());
+    return *this;
+  }
+};
+
+template <typename Owner, bool Const> class SoAIterator {
+  using OwnerPtr = std::conditional_t<Const, const Owner *, Owner *>;
+
+  template <typename, bool> friend class SoAIterator;
+
+  OwnerPtr owner_ = nullptr;
+  std::size_t index_ = 0;
+
+public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = typename Owner::value_type;
+  using difference_type = std::ptrdiff_t;
+  using reference = SoARow<Owner, Const>;
+  using pointer = void;
+
+  SoAIterator() = default;
+  SoAIterator(OwnerPtr owner, std::size_t index)
+      : owner_(owner), index_(index) {}
+
+  template <bool C = Const, typename = std::enable_if_t<C>>
+  SoAIterator(const SoAIterator<Owner, false> &it)
+      : owner_(it.owner_), index_(it.index_) {}
+
+  reference operator*() const { return {owner_, index_}; }
+  reference operator[](difference_type n) const {
+    return {owner_, index_ + n};
+  }
+
+  SoAIterator &operator++() {
+    ++index_;
+    return *this;
+  }
+  SoAIterator operator++(int) { return {owner_, index_++}; }
+  SoAIterator &operator--() {
+    --index_;
+    return *this;
+  }
+  SoAIterator operator--(int) { return {owner_, index_--}; }
+  SoAIterator &operator+=(difference_type n) {
+    index_ += n;
+    return *this;
+  }
+  SoAIterator &operator-=(difference_type n) {
+    index_ -= n;
+    return *this;
+  }
+  friend SoAIterator operator+(SoAIterator it, difference_type n) {
+    return it += n;
+  }
+  friend SoAIterator operator+(difference_type n, SoAIterator it) {
+    return it += n;
+  }
+  friend SoAIterator operator-(SoAIterator it, difference_type n) {
+    return it -= n;
+  }
+  friend difference_type operator-(const SoAIterator &lhs,
+                                   const SoAIterator &rhs) {
+    return static_cast<difference_type>(lhs.index_)
+           - static_cast<difference_type>(rhs.index_);
+  }
+
+  friend bool operator==(const SoAIterator &lhs, const SoAIterator &rhs) {
+    return lhs.index_ == rhs.index_;
+  }
+  friend bool operator!=(const SoAIterator &lhs, const SoAIterator &rhs) {
+    return lhs.index_ != rhs.index_;
+  }
+  friend bool operator<(const SoAIterator &lhs, const SoAIterator &rhs) {
+    return lhs.index_ < rhs.index_;
+  }
+  friend bool operator>(const SoAIterator &lhs, const SoAIterator &rhs) {
+    return rhs < lhs;
+  }
+  friend bool operator<=(const SoAIterator &lhs, const SoAIterator &rhs) {
+    return !(rhs < lhs);
+  }
+  friend bool operator>=(const SoAIterator &lhs, const SoAIterator &rhs) {
+    return !(lhs < rhs);
+  }
+};
+
+// map() over an SoA keeps the layout when the element type is unchanged
+// and otherwise yields a single-column SoA of the new type.
+template <typename Record, auto... Members, typename NewT>
+struct Rebind<SoA<Record, Members...>, NewT> {
+  using type = std::conditional_t<std::is_same_v<Record, NewT>,
+                                  SoA<Record, Members...>, SoA<NewT>>;
+};
+
+} // namespace impl
+
+// Structure-of-arrays storage for Record: one std::vector per listed
+// member, so a pass that reads two fields of a wide record streams only
+// those two columns. stream() accepts it like any container; its elements
+// are row proxies that convert to Record (gathering every column) or give
+// single fields through caskell::get<&Record::field>(row). Members not
+// listed are value-initialized when a row is gathered.
+template <typename Record, auto... Members> class SoA {
+  static_assert((std::is_same_v<typename impl::MemberOf<
+                                    decltype(Members)>::Class,
+                                Record>
+                 && ...),
+                "SoA members must be data members of Record");
+
+  template <typename, bool> friend class impl::SoARow;
+
+  std::tuple<std::vector<typename impl::MemberOf<decltype(Members)>::Field>...>
+      columns_;
+
+  template <std::size_t... I>
+  Record gatherImpl(std::size_t i, std::index_sequence<I...>) const {
+    Record record{};
+    ((record.*Members = std::get<I>(columns_)[i]), ...);
+    return record;
+  }
+
+  template <typename R, std::size_t... I>
+  void scatterImpl(std::size_t i, R &&record, std::index_sequence<I...>) {
+    ((std::get<I>(columns_)[i] = std::forward<R>(record).*Members), ...);
+  }
+
+  template <std::size_t... I>
+  void copyRowImpl(std::size_t i, const SoA &from, std::size_t j,
+                   std::index_sequence<I...>) {
+    ((std::get<I>(columns_)[i] = std::get<I>(from.columns_)[j]), ...);
+  }
+
+  using Indices = std::index_sequence_for<decltype(Members)...>;
+
+public:
+  using value_type = Record;
+  using size_type = std::size_t;
+  using reference = impl::SoARow<SoA, false>;
+  using const_reference = impl::SoARow<SoA, true>;
+  using iterator = impl::SoAIterator<SoA, false>;
+  using const_iterator = impl::SoAIterator<SoA, true>;
+
+  SoA() = default;
+  explicit SoA(std::size_t count) { resize(count); }
+  SoA(std::initializer_list<Record> records) {
+    reserve(records.size());
+    for (const Record &record : records)
+      push_back(record);
+  }
+
+  // Splits a vector of records into columns.
+  static SoA fromAoS(const std::vector<Record> &records) {
+    SoA result;
+    result.reserve(records.size());
+    for (const Record &record : records)
+      result.push_back(record);
+    return result;
+  }
+
+  // Rebuilds the records, e.g. to hand a result to array-of-structs code.
+  std::vector<Record> toAoS() const {
+    std::vector<Record> records;
+    records.reserve(size());
+    for (std::size_t i = 0; i < size(); ++i)
+      records.push_back(gather(i));
+    return records;
+  }
+
+  template <auto Member> auto &column() {
+    constexpr std::size_t I = impl::MemberIndex<Member, Members...>::value;
+    static_assert(I < sizeof...(Members), "member is not a column of this SoA");
+    return std::get<I>(columns_);
+  }
+
+  template <auto Member> const auto &column() const {
+    constexpr std::size_t I = impl::MemberIndex<Member, Members...>::value;
+    static_assert(I < sizeof...(Members), "member is not a column of this SoA");
+    return std::get<I>(columns_);
+  }
+
+  std::size_t size() const { return std::get<0>(columns_).size(); }
+  bool empty() const { return size() == 0; }
+
+  void reserve(std::size_t count) {
+    std::apply([count](auto &...column) { (column.reserve(count), ...); },
+               columns_);
+  }
+
+  void resize(std::size_t count) {
+    std::apply([count](auto &...column) { (column.resize(count), ...); },
+               columns_);
+  }
+
+  void clear() {
+    std::apply([](auto &...column) { (column.clear(), ...); }, columns_);
+  }
+
+  void push_back(const Record &record) {
+    std::apply(
+        [&record](auto &...column) {
+          (column.push_back(record.*Members), ...);
+        },
+        columns_);
+  }
+
+  void push_back(Record &&record) {
+    std::apply(
+        [&record](auto &...column) {
+          (column.push_back(std::move(record.*Members)), ...);
+        },
+        columns_);
+  }
+
+  // Rows of an SoA of the same type are copied column by column, without
+  // materializing a Record.
+  template <bool Const> void push_back(const impl::SoARow<SoA, Const> &row) {
+    appendRow(*row.owner(), row.index(), Indices{});
+  }
+
+  Record gather(std::size_t i) const { return gatherImpl(i, Indices{}); }
+
+  template <typename R> void scatter(std::size_t i, R &&record) {
+    scatterImpl(i, std::forward<R>(record), Indices{});
+  }
+
+  void copyRow(std::size_t i, const SoA &from, std::size_t j) {
+    copyRowImpl(i, from, j, Indices{});
+  }
+
+  reference operator[](std::size_t i) { return {this, i}; }
+  const_reference operator[](std::size_t i) const { return {this, i}; }
+
+  iterator begin() { return {this, 0}; }
+  iterator end() { return {this, size()}; }
+  const_iterator begin() const { return {this, 0}; }
+  const_iterator end() const { return {this, size()}; }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    std::size_t from = first - begin(), to = last - begin();
+    std::apply(
+        [from, to](auto &...column) {
+          (column.erase(column.begin() + from, column.begin() + to), ...);
+        },
+        columns_);
+    return {this, from};
+  }
+
+  friend bool operator==(const SoA &lhs, const SoA &rhs) {
+    return lhs.columns_ == rhs.columns_;
+  }
+  friend bool operator!=(const SoA &lhs, const SoA &rhs) {
+    return !(lhs == rhs);
+  }
+
+private:
+  template <std::size_t... I>
+  void appendRow(const SoA &from, std::size_t j, std::index_sequence<I...>) {
+    (std::get<I>(columns_).push_back(std::get<I>(from.columns_)[j]), ...);
+  }
+};
+
+// The single-column case, produced when map() changes the element type of
+// an SoA stream: a plain vector of T.
+template <typename T> class SoA<T> : public std::vector<T> {
+public:
+  using std::vector<T>::vector;
+
+  std::vector<T> toAoS() const { return *this; }
+};
+
+// Reads one field of a record or of an SoA row. On a row only the column
+// holding that field is touched.
+template <auto Member, typename Owner, bool Const>
+decltype(auto) get(const impl::SoARow<Owner, Const> &row) {
+  return row.template get<Member>();
+}
+
+template <auto Member, typename Record>
+auto get(const Record &record) -> const
+    typename impl::MemberOf<decltype(Member)>::Field & {
+  return record.*Member;
+}
+
+} // namespace caskell
+
+#endif // CASKELL_SOA_HPP
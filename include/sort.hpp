@@ -0,0 +1,223 @@
+#pragma once
+#ifndef CASKELL_SORT_HPP
+#define CASKELL_SORT_HPP
+
+#include "arena.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+
+namespace caskell {
+namespace impl {
+
+// Keys sorted by LSD radix sort when ordered by std::less or std::greater:
+// integers other than bool, float and double.
+template <typename Key>
+inline constexpr bool IsRadixKey
+    = (std::is_integral_v<Key> && !std::is_same_v<Key, bool>)
+      || std::is_same_v<Key, float> || std::is_same_v<Key, double>;
+
+// 1 for an ascending and -1 for a descending built-in order, 0 otherwise.
+template <typename Compare, typename Key>
+inline constexpr int RadixDirection
+    = std::is_same_v<Compare, std::less<>>
+              || std::is_same_v<Compare, std::less<Key>>
+          ? 1
+      : std::is_same_v<Compare, std::greater<>>
+              || std::is_same_v<Compare, std::greater<Key>>
+          ? -1
+          : 0;
+
+// Below this size std::stable_sort beats the fixed cost of the passes.
+inline constexpr std::size_t RadixThreshold = 256;
+
+// The bits of key as an unsigned integer whose order is the order of key.
+// -0.0 is folded into 0.0 so that the two compare equal, as under <.
+template <typename Key> auto radixBits(Key key) {
+  if constexpr (std::is_floating_point_v<Key>) {
+    using U = std::conditional_t<sizeof(Key) == 4, std::uint32_t,
+                                 std::uint64_t>;
+    if (key == 0)
+      key = 0;
+    U bits;
+    std::memcpy(&bits, &key, sizeof bits);
+    constexpr U sign = U(1) << (sizeof(U) * 8 - 1);
+    return bits & sign ? U(~bits) : U(bits | sign);
+  } else {
+    using U = std::make_unsigned_t<Key>;
+    constexpr U sign = std::is_signed_v<Key> ? U(1) << (sizeof(U) * 8 - 1)
+                                             : U(0);
+    return U(U(key) ^ sign);
+  }
+}
+
+// Stable sort of (bits, position) pairs by bits, RadixBits bits per pass:
+// three passes for 32-bit keys. All digit histograms are taken in a single
+// read, and digits shared by every key are skipped.
+inline constexpr std::size_t RadixBits = 11;
+
+template <typename U, typename Position>
+void radixSort(ArenaVector<std::pair<U, Position>> &items) {
+  constexpr std::size_t Radix = std::size_t(1) << RadixBits;
+  constexpr std::size_t Passes = (sizeof(U) * 8 + RadixBits - 1) / RadixBits;
+  auto digit = [](U bits, std::size_t pass) {
+    return static_cast<std::size_t>(bits >> (RadixBits * pass)) & (Radix - 1);
+  };
+  ArenaVector<Position> counts(Passes * Radix);
+  for (const auto &item : items) {
+    for (std::size_t pass = 0; pass < Passes; ++pass)
+      ++counts[pass * Radix + digit(item.first, pass)];
+  }
+  ArenaVector<std::pair<U, Position>> scratch(items.size());
+  for (std::size_t pass = 0; pass < Passes; ++pass) {
+    Position *count = counts.data() + pass * Radix;
+    if (count[digit(items.front().first, pass)] == items.size())
+      continue;
+    Position offset = 0;
+    for (std::size_t d = 0; d < Radix; ++d)
+      offset += std::exchange(count[d], offset);
+    for (const auto &item : items)
+      scratch[count[digit(item.first, pass)]++] = item;
+    items.swap(scratch);
+  }
+}
+
+// Radix-sorted positions of the elements of range; Position is the
+// narrowest type that indexes them, which keeps the pairs moved by every
+// pass small.
+template <typename Position, int Direction, typename Range, typename KeyFn>
+ArenaVector<std::size_t> radixOrder(const Range &range, KeyFn &keyFn) {
+  using U = decltype(radixBits(keyFn(*std::begin(range))));
+  ArenaVector<std::pair<U, Position>> items;
+  items.reserve(range.size());
+  Position i = 0;
+  for (const auto &item : range) {
+    U bits = radixBits(keyFn(item));
+    items.emplace_back(Direction > 0 ? bits : U(~bits), i++);
+  }
+  radixSort(items);
+  ArenaVector<std::size_t> order;
+  order.reserve(items.size());
+  for (const auto &item : items)
+    order.push_back(item.second);
+  return order;
+}
+
+template <typename Range, typename KeyFn>
+auto keysOf(const Range &range, KeyFn &keyFn) {
+  using Key = std::decay_t<decltype(keyFn(*std::begin(range)))>;
+  ArenaVector<Key> keys;
+  keys.reserve(range.size());
+  for (const auto &item : range)
+    keys.push_back(keyFn(item));
+  return keys;
+}
+
+// Positions 0..n-1 of the elements of range in compare order of their
+// keys, equal keys in position order. Radix keys are converted straight
+// into sort items; other keys are computed once and stable-sorted.
+template <typename Range, typename KeyFn, typename Compare>
+ArenaVector<std::size_t> sortedOrder(const Range &range, KeyFn &keyFn,
+                                     Compare &compare) {
+  using Key = std::decay_t<decltype(keyFn(*std::begin(range)))>;
+  constexpr int Direction = RadixDirection<Compare, Key>;
+  if constexpr (IsRadixKey<Key> && Direction != 0) {
+    if (range.size() >= RadixThreshold) {
+      if (range.size() <= UINT32_MAX)
+        return radixOrder<std::uint32_t, Direction>(range, keyFn);
+      return radixOrder<std::size_t, Direction>(range, keyFn);
+    }
+  }
+  auto keys = keysOf(range, keyFn);
+  ArenaVector<std::size_t> order(keys.size());
+  std::iota(order.begin(), order.end(), std::size_t(0));
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t a, std::size_t b) {
+                     return compare(keys[a], keys[b]);
+                   });
+  return order;
+}
+
+// The first k positions of sortedOrder(range, keyFn, compare), found by
+// selection rather than a full sort.
+template <typename Range, typename KeyFn, typename Compare>
+ArenaVector<std::size_t> firstOrder(const Range &range, std::size_t k,
+                                    KeyFn &keyFn, Compare &compare) {
+  if (k >= range.size())
+    return sortedOrder(range, keyFn, compare);
+  auto keys = keysOf(range, keyFn);
+  auto before = [&](std::size_t a, std::size_t b) {
+    return compare(keys[a], keys[b])
+           || (!compare(keys[b], keys[a]) && a < b);
+  };
+  ArenaVector<std::size_t> order(keys.size());
+  std::iota(order.begin(), order.end(), std::size_t(0));
+  std::nth_element(order.begin(), order.begin() + k, order.end(), before);
+  order.resize(k);
+  std::sort(order.begin(), order.end(), before);
+  return order;
+}
+
+// The k first elements of a sequence in compare order of their keys, ties
+// going to the earlier element, selected as the elements go past. A heap
+// holds the best k so far with the worst on top, so memory is O(k) and
+// an element is copied only when it makes the cut.
+template <typename T, typename Key, typename Compare> class TopKHeap {
+  struct Entry {
+    Key key;
+    std::size_t seq;
+    T value;
+  };
+
+  ArenaVector<Entry> heap_;
+  std::size_t k_;
+  std::size_t seen_ = 0;
+  Compare compare_;
+
+  auto before() const {
+    return [this](const Entry &a, const Entry &b) {
+      return compare_(a.key, b.key)
+             || (!compare_(b.key, a.key) && a.seq < b.seq);
+    };
+  }
+
+public:
+  TopKHeap(std::size_t k, Compare compare)
+      : k_(k), compare_(std::move(compare)) {
+    heap_.reserve(k);
+  }
+
+  template <typename U> void push(Key key, U &&value) {
+    std::size_t seq = seen_++;
+    if (heap_.size() < k_) {
+      heap_.push_back(Entry{std::move(key), seq, std::forward<U>(value)});
+      std::push_heap(heap_.begin(), heap_.end(), before());
+    } else if (k_ > 0 && compare_(key, heap_.front().key)) {
+      std::pop_heap(heap_.begin(), heap_.end(), before());
+      heap_.back() = Entry{std::move(key), seq, std::forward<U>(value)};
+      std::push_heap(heap_.begin(), heap_.end(), before());
+    }
+  }
+
+  template <typename Out> Out finish() && {
+    std::sort_heap(heap_.begin(), heap_.end(), before());
+    Out result;
+    if constexpr (HasMember_reserve<Out>::value) {
+      result.reserve(heap_.size());
+    }
+    for (auto &entry : heap_)
+      append(result, std::move(entry.value));
+    return result;
+  }
+};
+
+} // namespace impl
+} // namespace caskell
+
+#endif // CASKELL_SORT_HPP
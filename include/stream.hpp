@@ -2,9 +2,19 @@
 #ifndef CASKELL_STREAM_HPP
 #define CASKELL_STREAM_HPP
 
+#include "arena.hpp"
+#include "flat_hash_map.hpp"
+#include "fusion.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "sort.hpp"
+#include "utils.hpp"
+#include <iterator>
 #include <memory>
+#include <optional>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace caskell {
 namespace impl {
@@ -26,44 +36,391 @@ struct Rebind<Container<T>, NewT> {
 template <typename Container, typename NewT>
 using Rebind_t = typename Rebind<Container, NewT>::type;
 
-template <typename Container> struct Stream : public Container {
-  using ValueType = typename Container::value_type;
+// Left fold of a whole container. Reductions recognised by simd.hpp over
+// contiguous arithmetic data run through the vector kernels instead.
+template <typename T, typename Func, typename Container>
+T foldContainer(const Container &container, Func &func, T init) {
+  if constexpr (HasMember_data<Container>::value
+                && simd::Vectorizable<Func, T,
+                                      typename Container::value_type>) {
+    return simd::reduce(func, std::move(init), container.data(),
+                        container.size());
+  } else {
+    for (const auto &item : container) {
+      init = func(init, item);
+    }
+    return init;
+  }
+}
 
-  Stream(Container &&container) : Container(std::move(container)) {}
+template <typename Container> struct Stream;
+
+// A deferred map/filter chain over a container. Nothing runs until a
+// terminal operation, which walks the source once through every stage.
+// Source is the container itself when the pipeline owns it, or a const
+// reference when it was built by Stream::view(). Extending a named
+// pipeline copies an owned container and shares a borrowed one.
+template <typename Source, typename T, typename Stage> class FusedStream {
+  using Container = std::remove_cv_t<std::remove_reference_t<Source>>;
+
+  Source source_;
+  Stage stage_;
 
-  template <typename Pred> Stream filter(Pred pred) {
-    auto slowPtr = this->begin();
-    auto fastPtr = this->begin();
-    auto end = this->end();
-    while (fastPtr != end) {
-      if (pred(*fastPtr)) {
-        *slowPtr = *fastPtr;
-        ++slowPtr;
+  template <typename Sink> void run(Sink &&sink) const {
+    for (const auto &item : source_)
+      stage_(item, sink);
+  }
+
+  // Like run(), but an owned source hands its elements over by move.
+  template <typename Sink> void drain(Sink &&sink) {
+    if constexpr (std::is_reference_v<Source>) {
+      run(sink);
+    } else {
+      for (auto &&item : source_)
+        stage_(std::move(item), sink);
+    }
+  }
+
+  // Every stage emits at most one element per input, so the source size
+  // bounds the output and a reservable container is allocated once. The
+  // bound is reserved in full even behind a filter: it is no larger than
+  // the source, which is already in memory. A filtered result using less
+  // than half of it is shrunk afterwards, at the cost of one more
+  // allocation.
+  template <typename Out, typename Runner>
+  static Out fill(std::size_t bound, Runner &&runner) {
+    Out result;
+    if constexpr (HasMember_reserve<Out>::value) {
+      result.reserve(bound);
+    }
+    runner([&](auto &&item) {
+      if constexpr (HasMember_push_back<Out>::value) {
+        result.push_back(std::forward<decltype(item)>(item));
+      } else {
+        result.insert(result.end(), std::forward<decltype(item)>(item));
       }
-      ++fastPtr;
+    });
+    if constexpr (IsSelective<Stage>::value
+                  && HasMember_shrink_to_fit<Out>::value) {
+      if (result.size() < result.capacity() / 2)
+        result.shrink_to_fit();
+    }
+    return result;
+  }
+
+public:
+  using ValueType = T;
+
+  template <typename S>
+  FusedStream(S &&source, Stage stage)
+      : source_(std::forward<S>(source)), stage_(std::move(stage)) {}
+
+  template <typename Func> auto map(Func func) const & {
+    return withStage<std::decay_t<decltype(func(std::declval<T>()))>, Source>(
+        source_, MapStage<Stage, Func>{stage_, std::move(func)});
+  }
+
+  template <typename Func> auto map(Func func) && {
+    return withStage<std::decay_t<decltype(func(std::declval<T>()))>, Source>(
+        std::move(source_),
+        MapStage<Stage, Func>{std::move(stage_), std::move(func)});
+  }
+
+  template <typename Pred> auto filter(Pred pred) const & {
+    return withStage<T, Source>(
+        source_, FilterStage<Stage, Pred>{stage_, std::move(pred)});
+  }
+
+  template <typename Pred> auto filter(Pred pred) && {
+    return withStage<T, Source>(
+        std::move(source_),
+        FilterStage<Stage, Pred>{std::move(stage_), std::move(pred)});
+  }
+
+  template <typename Func,
+            typename = std::enable_if_t<std::is_invocable_v<Func, T, T>>>
+  T reduce(Func func, T init) const {
+    if constexpr (simd::Vectorizable<Func, T, T>) {
+      simd::BlockReducer<Func, T, T> reducer(func, std::move(init));
+      run([&](const T &item) { reducer.push(item); });
+      return reducer.finish();
+    } else {
+      run([&](auto &&item) { init = func(std::move(init), item); });
+      return init;
     }
-    this->erase(slowPtr, end);
+  }
+
+  template <typename Func,
+            typename = std::enable_if_t<std::is_invocable_v<Func, T>>>
+  void forEach(Func func) const {
+    run([&](auto &&item) { func(item); });
+  }
+
+  // sortBy materializes the pipeline; topK streams it through a heap of k
+  // elements. Both order like Stream::sortBy.
+  template <typename KeyFn, typename Compare = std::less<>>
+  auto sortBy(KeyFn keyFn, Compare compare = Compare()) const & {
+    return Stream<Rebind_t<Container, T>>(collect())
+        .sortBy(std::move(keyFn), std::move(compare));
+  }
+
+  template <typename KeyFn, typename Compare = std::less<>>
+  auto sortBy(KeyFn keyFn, Compare compare = Compare()) && {
+    return Stream<Rebind_t<Container, T>>(std::move(*this).collect())
+        .sortBy(std::move(keyFn), std::move(compare));
+  }
+
+  template <typename KeyFn, typename Compare = std::less<>>
+  auto topK(std::size_t k, KeyFn keyFn, Compare compare = Compare()) const & {
+    return selectTop(k, keyFn, std::move(compare),
+                     [this](auto &&sink) { run(std::move(sink)); });
+  }
+
+  template <typename KeyFn, typename Compare = std::less<>>
+  auto topK(std::size_t k, KeyFn keyFn, Compare compare = Compare()) && {
+    return selectTop(k, keyFn, std::move(compare),
+                     [this](auto &&sink) { drain(std::move(sink)); });
+  }
+
+  template <typename Out = Rebind_t<Container, T>> Out collect() const & {
+    return fill<Out>(source_.size(),
+                     [this](auto &&sink) { run(std::move(sink)); });
+  }
+
+  // An owned source whose element type survives the pipeline is compacted
+  // in place: each result is move-assigned over an already consumed slot,
+  // so neither elements nor the buffer are copied. Containers of proxies
+  // such as SoA are rebuilt instead.
+  template <typename Out = Rebind_t<Container, T>> Out collect() && {
+    if constexpr (!std::is_reference_v<Source>
+                  && std::is_same_v<Out, Container>
+                  && std::is_reference_v<decltype(*source_.begin())>) {
+      auto write = source_.begin();
+      for (auto read = source_.begin(); read != source_.end(); ++read) {
+        stage_(std::move(*read), [&](auto &&value) {
+          if (std::addressof(*write) != std::addressof(value))
+            *write = std::forward<decltype(value)>(value);
+          ++write;
+        });
+      }
+      source_.erase(write, source_.end());
+      return std::move(source_);
+    } else {
+      return fill<Out>(source_.size(),
+                       [this](auto &&sink) { drain(std::move(sink)); });
+    }
+  }
+
+private:
+  template <typename KeyFn, typename Compare, typename Runner>
+  static auto selectTop(std::size_t k, KeyFn &keyFn, Compare compare,
+                        Runner &&runner) {
+    using Key = std::decay_t<std::invoke_result_t<KeyFn &, const T &>>;
+    using Out = Rebind_t<Container, T>;
+    TopKHeap<T, Key, Compare> heap(k, std::move(compare));
+    runner([&](auto &&item) {
+      heap.push(keyFn(item), std::forward<decltype(item)>(item));
+    });
+    return Stream<Out>(std::move(heap).template finish<Out>());
+  }
+
+  template <typename U, typename NewSource, typename S, typename NewStage>
+  static auto withStage(S &&source, NewStage stage) {
+    return FusedStream<NewSource, U, NewStage>(std::forward<S>(source),
+                                               std::move(stage));
+  }
+};
+
+// Building blocks of the hash-based operations on Stream and
+// ParallelStream. They fill a FlatHashMap from an iterator range, so a
+// parallel stream can build one table per part and merge the tables in
+// part order. Keys therefore come out in order of first occurrence and
+// elements keep their source order within a key.
+template <typename T, typename KeyFn>
+using KeyOf = std::decay_t<std::invoke_result_t<KeyFn &, const T &>>;
+
+struct NoValue {};
+
+template <typename Out, typename T> Out toContainer(std::vector<T> &&items) {
+  if constexpr (std::is_same_v<Out, std::vector<T>>) {
+    return std::move(items);
+  } else {
+    return Out(std::make_move_iterator(items.begin()),
+               std::make_move_iterator(items.end()));
+  }
+}
+
+template <typename Key, typename Group, typename It, typename KeyFn>
+void groupInto(FlatHashMap<Key, Group> &table, It first, It last,
+               KeyFn &keyFn) {
+  for (; first != last; ++first)
+    table.tryEmplace(keyFn(*first)).first->push_back(*first);
+}
+
+template <typename Key, typename Group>
+void mergeGroups(FlatHashMap<Key, Group> &into,
+                 FlatHashMap<Key, Group> &&part) {
+  for (auto &[key, items] : part) {
+    auto [group, inserted] = into.tryEmplace(std::move(key), std::move(items));
+    if (!inserted)
+      group->insert(group->end(), std::make_move_iterator(items.begin()),
+                    std::make_move_iterator(items.end()));
+  }
+}
+
+template <typename Key, typename T, typename It, typename KeyFn,
+          typename Reducer>
+void reduceInto(FlatHashMap<Key, T> &table, It first, It last, KeyFn &keyFn,
+                Reducer &reducer) {
+  for (; first != last; ++first) {
+    auto [acc, inserted] = table.tryEmplace(keyFn(*first), *first);
+    if (!inserted)
+      *acc = reducer(std::move(*acc), *first);
+  }
+}
+
+template <typename Key, typename T, typename Reducer>
+void mergeReduced(FlatHashMap<Key, T> &into, FlatHashMap<Key, T> &&part,
+                  Reducer &reducer) {
+  for (auto &[key, value] : part) {
+    auto [acc, inserted] = into.tryEmplace(std::move(key), std::move(value));
+    if (!inserted)
+      *acc = reducer(std::move(*acc), std::move(value));
+  }
+}
+
+template <typename T, typename It>
+void distinctInto(FlatHashMap<T, NoValue> &seen, It first, It last) {
+  for (; first != last; ++first)
+    seen.tryEmplace(*first);
+}
+
+template <typename Out, typename T>
+Out distinctKeys(FlatHashMap<T, NoValue> &&seen) {
+  Out result;
+  if constexpr (HasMember_reserve<Out>::value) {
+    result.reserve(seen.size());
+  }
+  for (auto &entry : seen)
+    result.push_back(std::move(entry.first));
+  return result;
+}
+
+// Build side of a hash join: the rows of one container, chained per key
+// through an index array rather than a list per key.
+template <typename Key, typename Row> class JoinIndex {
+  static constexpr std::size_t End = static_cast<std::size_t>(-1);
+
+  struct Chain {
+    std::size_t first;
+    std::size_t last;
+  };
+
+  ArenaVector<const Row *> rows_;
+  ArenaVector<std::size_t> next_;
+  FlatHashMap<Key, Chain> heads_;
+
+public:
+  template <typename Container, typename KeyFn>
+  JoinIndex(const Container &build, KeyFn &keyFn) : heads_(build.size()) {
+    rows_.reserve(build.size());
+    next_.reserve(build.size());
+    for (const auto &row : build) {
+      std::size_t index = rows_.size();
+      rows_.push_back(&row);
+      next_.push_back(End);
+      auto [chain, inserted]
+          = heads_.tryEmplace(keyFn(row), Chain{index, index});
+      if (!inserted) {
+        next_[chain->last] = index;
+        chain->last = index;
+      }
+    }
+  }
+
+  // Calls f(row) for every build row whose key equals key, in build order.
+  template <typename F> void forEachMatch(const Key &key, F &&f) const {
+    if (const Chain *chain = heads_.find(key)) {
+      for (std::size_t i = chain->first; i != End; i = next_[i])
+        f(*rows_[i]);
+    }
+  }
+};
+
+// Keeps the elements of container satisfying pred, moving survivors
+// forward over the rejected ones.
+template <typename Container, typename Pred>
+void compactInPlace(Container &container, Pred &pred) {
+  auto slowPtr = container.begin();
+  auto fastPtr = container.begin();
+  auto end = container.end();
+  while (fastPtr != end) {
+    if (pred(*fastPtr)) {
+      if (slowPtr != fastPtr)
+        *slowPtr = std::move(*fastPtr);
+      ++slowPtr;
+    }
+    ++fastPtr;
+  }
+  container.erase(slowPtr, end);
+}
+
+// The original eager stream: every map/filter runs immediately, in place on
+// a mutable stream and into a fresh container on a const one. Calls on an
+// rvalue stream move the container along the chain instead of copying it.
+template <typename Container> struct EagerStream : public Container {
+  using ValueType = typename Container::value_type;
+
+  EagerStream(Container &&container) : Container(std::move(container)) {}
+
+  template <typename Pred> EagerStream filter(Pred pred) & {
+    compactInPlace(static_cast<Container &>(*this), pred);
     return *this;
   }
 
-  template <typename Pred> Stream filter(Pred pred) const {
+  template <typename Pred> EagerStream filter(Pred pred) && {
+    compactInPlace(static_cast<Container &>(*this), pred);
+    return std::move(*this);
+  }
+
+  template <typename Pred> EagerStream filter(Pred pred) const & {
     Container result;
     for (const auto &item : *this) {
       if (pred(item)) {
         result.push_back(item);
       }
     }
-    return Stream(result);
+    return EagerStream(std::move(result));
   }
 
-  template <typename Func> auto map(Func func) {
+  template <typename Func> auto map(Func func) & {
     for (auto &item : *this) {
       item = func(item);
     }
     return *this;
   }
 
-  template <typename Func> auto map(Func func) const {
+  // Results of the element type are written back in place; any other
+  // result type gets a new container fed with the moved-out elements.
+  template <typename Func> auto map(Func func) && {
+    using ReturnType = std::decay_t<decltype(func(std::declval<ValueType>()))>;
+    if constexpr (std::is_same_v<ReturnType, ValueType>) {
+      for (auto &item : *this) {
+        item = func(std::move(item));
+      }
+      return std::move(*this);
+    } else {
+      using NewContainer = Rebind_t<Container, ReturnType>;
+      NewContainer result;
+      result.reserve(this->size());
+      for (auto &item : *this) {
+        result.push_back(func(std::move(item)));
+      }
+      return EagerStream<NewContainer>(std::move(result));
+    }
+  }
+
+  template <typename Func> auto map(Func func) const & {
     using ReturnType = decltype(func((*this)[0]));
     using NewContainer = Rebind_t<Container, ReturnType>;
     NewContainer result;
@@ -71,20 +428,383 @@ template <typename Container> struct Stream : public Container {
     for (const auto &item : *this) {
       result.push_back(func(item));
     }
-    return Stream(std::move(result));
+    return EagerStream<NewContainer>(std::move(result));
   }
 
   template <typename Func,
             typename
             = std::enable_if_t<std::is_invocable_v<Func, ValueType, ValueType>>>
   auto reduce(Func func, ValueType &&init) const {
-    auto it = std::forward<ValueType>(init);
+    return foldContainer<ValueType>(static_cast<const Container &>(*this),
+                                    func, std::forward<ValueType>(init));
+  }
+
+  template <typename Func,
+            typename = std::enable_if_t<std::is_invocable_v<Func, ValueType>>>
+  auto forEach(Func func) const {
     for (const auto &item : *this) {
-      it = func(it, item);
+      func(item);
     }
+    return *this;
+  }
+
+  Container collect() && { return std::move(static_cast<Container &>(*this)); }
+
+  Container collect() const & { return static_cast<Container>(*this); }
+
+};
+
+// A stream whose operations run immediately across the shared thread pool.
+// The container must be random access. Work is cut into contiguous parts
+// whose boundaries are multiples of ParallelAlign elements, so workers never
+// write to the same cache line (or the same std::vector<bool> word). Results
+// keep the source order; callables run concurrently and must be safe to
+// call from several threads.
+template <typename Container> struct ParallelStream : public Container {
+  using ValueType = typename Container::value_type;
+
+  static_assert(std::is_base_of_v<std::random_access_iterator_tag,
+                                  typename std::iterator_traits<
+                                      typename Container::iterator>::
+                                      iterator_category>,
+                "ParallelStream needs a random-access container");
+
+  ParallelStream(Container &&container) : Container(std::move(container)) {}
+
+  // Writes func(x) into a presized output; the result type must be default
+  // constructible.
+  template <typename Func> auto map(Func func) const & {
+    using ReturnType = std::decay_t<decltype(func(std::declval<ValueType>()))>;
+    using NewContainer = Rebind_t<Container, ReturnType>;
+    NewContainer result(this->size());
+    forParts([&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i)
+        result[i] = func((*this)[i]);
+    });
+    return ParallelStream<NewContainer>(std::move(result));
+  }
+
+  template <typename Func> auto map(Func func) && {
+    using ReturnType = std::decay_t<decltype(func(std::declval<ValueType>()))>;
+    if constexpr (std::is_same_v<ReturnType, ValueType>) {
+      forParts([&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+          (*this)[i] = func(std::move((*this)[i]));
+      });
+      return std::move(*this);
+    } else {
+      using NewContainer = Rebind_t<Container, ReturnType>;
+      NewContainer result(this->size());
+      forParts([&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+          result[i] = func(std::move((*this)[i]));
+      });
+      return ParallelStream<NewContainer>(std::move(result));
+    }
+  }
+
+  // Three passes: each part flags and counts its survivors, an exclusive
+  // prefix sum over the counts gives every part its output offset, and the
+  // parts then scatter their survivors into a presized output.
+  template <typename Pred> ParallelStream filter(Pred pred) const & {
+    return scatter(*this, pred);
+  }
+
+  template <typename Pred> ParallelStream filter(Pred pred) && {
+    return scatter(*this, pred);
+  }
+
+  template <typename Func,
+            typename = std::enable_if_t<std::is_invocable_v<Func, ValueType>>>
+  void forEach(Func func) const {
+    forParts([&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i)
+        func((*this)[i]);
+    });
+  }
+
+  // func must be associative. Each part folds its own elements, partial
+  // results are combined pairwise in a tree that preserves their order,
+  // and init is folded in last, so init need not be an identity. Counting
+  // reductions (ops::countIf) start every part at zero and add the counts.
+  template <typename Func,
+            typename
+            = std::enable_if_t<std::is_invocable_v<Func, ValueType, ValueType>>>
+  auto reduce(Func func, ValueType &&init) const {
+    constexpr bool counting
+        = simd::Reduction<Func>::kind == simd::Kind::CountIf;
+    std::vector<std::optional<ValueType>> partials(parts());
+    forParts([&](std::size_t begin, std::size_t end, std::size_t part) {
+      if constexpr (counting) {
+        partials[part].emplace(foldPart(func, ValueType(), begin, end));
+      } else {
+        partials[part].emplace(
+            foldPart(func, ValueType((*this)[begin]), begin + 1, end));
+      }
+    });
+    auto combine = [&func](ValueType lhs, ValueType rhs) {
+      if constexpr (counting) {
+        return ValueType(lhs + rhs);
+      } else {
+        return ValueType(func(std::move(lhs), std::move(rhs)));
+      }
+    };
+    for (std::size_t stride = 1; stride < partials.size(); stride *= 2) {
+      std::size_t pairs = (partials.size() - stride + 2 * stride - 1)
+                          / (2 * stride);
+      parallelFor(pairs, [&](std::size_t pair) {
+        std::size_t left = pair * 2 * stride;
+        auto &lhs = partials[left];
+        auto &rhs = partials[left + stride];
+        lhs.emplace(combine(std::move(*lhs), std::move(*rhs)));
+      });
+    }
+    auto it = std::forward<ValueType>(init);
+    if (!partials.empty())
+      it = combine(std::move(it), std::move(*partials[0]));
     return it;
   }
 
+  // The hash-based operations of Stream. Every part builds its own table
+  // and the tables are merged in part order, so results match the
+  // sequential ones; reduceByKey needs an associative reducer.
+  template <typename KeyFn> auto groupBy(KeyFn keyFn) const {
+    using Key = KeyOf<ValueType, KeyFn>;
+    using Table = FlatHashMap<Key, Container>;
+    auto tables = partTables<Table>([&](Table &table, auto first, auto last) {
+      groupInto(table, first, last, keyFn);
+    });
+    Table table(this->size());
+    for (auto &part : tables)
+      mergeGroups(table, std::move(part));
+    using Out = Rebind_t<Container, std::pair<Key, Container>>;
+    return ParallelStream<Out>(toContainer<Out>(std::move(table).release()));
+  }
+
+  template <typename KeyFn, typename Reducer>
+  auto reduceByKey(KeyFn keyFn, Reducer reducer) const {
+    using Key = KeyOf<ValueType, KeyFn>;
+    using Table = FlatHashMap<Key, ValueType>;
+    auto tables = partTables<Table>([&](Table &table, auto first, auto last) {
+      reduceInto(table, first, last, keyFn, reducer);
+    });
+    Table table(this->size());
+    for (auto &part : tables)
+      mergeReduced(table, std::move(part), reducer);
+    using Out = Rebind_t<Container, std::pair<Key, ValueType>>;
+    return ParallelStream<Out>(toContainer<Out>(std::move(table).release()));
+  }
+
+  ParallelStream distinct() const {
+    using Table = FlatHashMap<ValueType, NoValue>;
+    auto tables = partTables<Table>([](Table &table, auto first, auto last) {
+      distinctInto(table, first, last);
+    });
+    Table seen(this->size());
+    for (auto &part : tables) {
+      for (auto &entry : part)
+        seen.tryEmplace(std::move(entry.first));
+    }
+    return ParallelStream(distinctKeys<Container>(std::move(seen)));
+  }
+
+  // The index over other is built once; parts probe it concurrently and
+  // their matches are concatenated in order.
+  template <typename Other, typename LeftKey, typename RightKey>
+  auto hashJoin(const Other &other, LeftKey leftKey, RightKey rightKey) const {
+    using Key = KeyOf<ValueType, LeftKey>;
+    using Row = typename Other::value_type;
+    using Pair = std::pair<ValueType, Row>;
+    using Out = Rebind_t<Container, Pair>;
+    JoinIndex<Key, Row> index(other, rightKey);
+    std::vector<std::vector<Pair>> matches(parts());
+    forParts([&](std::size_t begin, std::size_t end, std::size_t part) {
+      for (std::size_t i = begin; i < end; ++i) {
+        const ValueType &item = (*this)[i];
+        index.forEachMatch(leftKey(item), [&](const Row &row) {
+          matches[part].push_back(Pair(item, row));
+        });
+      }
+    });
+    Out result;
+    for (auto &part : matches)
+      result.insert(result.end(), std::make_move_iterator(part.begin()),
+                    std::make_move_iterator(part.end()));
+    return ParallelStream<Out>(std::move(result));
+  }
+
+  template <typename Other, typename KeyFn>
+  auto hashJoin(const Other &other, KeyFn keyFn) const {
+    return hashJoin(other, keyFn, keyFn);
+  }
+
+  Stream<Container> seq() && { return Stream<Container>(std::move(*this)); }
+
+  Stream<Container> seq() const & {
+    return Stream<Container>(Container(*this));
+  }
+
+  Container collect() && { return std::move(static_cast<Container &>(*this)); }
+
+  Container collect() const & { return static_cast<Container>(*this); }
+
+private:
+  static constexpr std::size_t ParallelAlign = 64;
+
+  // One part per worker, each at least ParallelGrain elements; none for an
+  // empty container.
+  std::size_t parts() const {
+    std::size_t size = this->size();
+    if (size == 0)
+      return 0;
+    std::size_t blocks = (size + ParallelAlign - 1) / ParallelAlign;
+    return std::min(partitionCount(size), blocks);
+  }
+
+  std::size_t boundary(std::size_t part, std::size_t count) const {
+    std::size_t blocks = (this->size() + ParallelAlign - 1) / ParallelAlign;
+    return std::min(this->size(), blocks * part / count * ParallelAlign);
+  }
+
+  // Folds elements [begin, end) into init, through a vector kernel when
+  // simd.hpp recognises func.
+  template <typename Func>
+  ValueType foldPart(Func &func, ValueType init, std::size_t begin,
+                     std::size_t end) const {
+    if constexpr (HasMember_data<Container>::value
+                  && simd::Vectorizable<Func, ValueType, ValueType>) {
+      return simd::reduce(func, std::move(init), this->data() + begin,
+                          end - begin);
+    } else {
+      for (std::size_t i = begin; i < end; ++i)
+        init = func(std::move(init), (*this)[i]);
+      return init;
+    }
+  }
+
+  // One table per part, filled by fill(table, first, last) in parallel.
+  // Tables are created on the worker, so they never grow inside the
+  // calling thread's arena.
+  template <typename Table, typename Fill>
+  std::vector<Table> partTables(Fill &&fill) const {
+    std::vector<Table> tables(parts());
+    forParts([&](std::size_t begin, std::size_t end, std::size_t part) {
+      tables[part] = Table(end - begin);
+      fill(tables[part], this->begin() + begin, this->begin() + end);
+    });
+    return tables;
+  }
+
+  // Calls body(begin, end[, part]) for every non-empty part.
+  template <typename Body> void forParts(Body &&body) const {
+    std::size_t count = parts();
+    parallelFor(count, [&](std::size_t part) {
+      std::size_t begin = boundary(part, count);
+      std::size_t end = boundary(part + 1, count);
+      if constexpr (std::is_invocable_v<Body &, std::size_t, std::size_t,
+                                        std::size_t>) {
+        body(begin, end, part);
+      } else {
+        body(begin, end);
+      }
+    });
+  }
+
+  // Survivors are moved out of a mutable stream and copied otherwise.
+  template <typename Self, typename Pred>
+  static ParallelStream scatter(Self &self, Pred &pred) {
+    std::size_t count = self.parts();
+    ArenaVector<unsigned char> keep(self.size());
+    ArenaVector<std::size_t> offsets(count + 1, 0);
+    self.forParts([&](std::size_t begin, std::size_t end, std::size_t part) {
+      std::size_t kept = 0;
+      for (std::size_t i = begin; i < end; ++i)
+        kept += keep[i] = pred(self[i]) ? 1 : 0;
+      offsets[part + 1] = kept;
+    });
+    for (std::size_t part = 0; part < count; ++part)
+      offsets[part + 1] += offsets[part];
+    Container result(offsets[count]);
+    self.forParts([&](std::size_t begin, std::size_t end, std::size_t part) {
+      std::size_t out = offsets[part];
+      for (std::size_t i = begin; i < end; ++i) {
+        if (!keep[i])
+          continue;
+        if constexpr (std::is_const_v<Self>) {
+          result[out++] = self[i];
+        } else {
+          result[out++] = std::move(self[i]);
+        }
+      }
+    });
+    return ParallelStream(std::move(result));
+  }
+};
+
+// map and filter on a temporary or const stream are deferred: they return
+// a FusedStream that runs all stages in one pass when collect(), reduce()
+// or forEach() is called. A pipeline built from a temporary stream takes
+// over its container and one built from a const stream copies it; view()
+// starts a pipeline that borrows the container instead and must not
+// outlive the stream. On a mutable lvalue stream, filter and element-type
+// map run immediately in place, as eager() streams do. par() runs each
+// stage across the thread pool.
+template <typename Container> struct Stream : public Container {
+  using ValueType = typename Container::value_type;
+
+  Stream(Container &&container) : Container(std::move(container)) {}
+
+  template <typename Pred> Stream &filter(Pred pred) & {
+    compactInPlace(container(), pred);
+    return *this;
+  }
+
+  template <typename Pred> auto filter(Pred pred) const & {
+    return FusedStream<Container, ValueType,
+                       FilterStage<IdentityStage, Pred>>(
+        container(), {IdentityStage{}, std::move(pred)});
+  }
+
+  template <typename Pred> auto filter(Pred pred) && {
+    return FusedStream<Container, ValueType,
+                       FilterStage<IdentityStage, Pred>>(
+        std::move(container()), {IdentityStage{}, std::move(pred)});
+  }
+
+  // A map to another element type cannot run in place and is deferred
+  // over a copy, as on a const stream.
+  template <typename Func> decltype(auto) map(Func func) & {
+    using ReturnType = std::decay_t<decltype(func(std::declval<ValueType>()))>;
+    if constexpr (std::is_same_v<ReturnType, ValueType>) {
+      for (auto &item : container()) {
+        item = func(item);
+      }
+      return *this;
+    } else {
+      return std::as_const(*this).map(std::move(func));
+    }
+  }
+
+  template <typename Func> auto map(Func func) const & {
+    using ReturnType = std::decay_t<decltype(func(std::declval<ValueType>()))>;
+    return FusedStream<Container, ReturnType, MapStage<IdentityStage, Func>>(
+        container(), {IdentityStage{}, std::move(func)});
+  }
+
+  template <typename Func> auto map(Func func) && {
+    using ReturnType = std::decay_t<decltype(func(std::declval<ValueType>()))>;
+    return FusedStream<Container, ReturnType, MapStage<IdentityStage, Func>>(
+        std::move(container()), {IdentityStage{}, std::move(func)});
+  }
+
+  template <typename Func,
+            typename
+            = std::enable_if_t<std::is_invocable_v<Func, ValueType, ValueType>>>
+  auto reduce(Func func, ValueType &&init) const {
+    return foldContainer<ValueType>(static_cast<const Container &>(*this),
+                                    func, std::forward<ValueType>(init));
+  }
+
   template <typename Func,
             typename = std::enable_if_t<std::is_invocable_v<Func, ValueType>>>
   auto forEach(Func func) const {
@@ -94,9 +814,165 @@ template <typename Container> struct Stream : public Container {
     return *this;
   }
 
+  // Hash-based relational operations, built on impl::FlatHashMap sized
+  // from the input. Keys appear in order of first occurrence.
+
+  // (key, elements with that key) pairs.
+  template <typename KeyFn> auto groupBy(KeyFn keyFn) const {
+    using Key = KeyOf<ValueType, KeyFn>;
+    using Group = std::pair<Key, Container>;
+    FlatHashMap<Key, Container> table(this->size());
+    groupInto(table, this->begin(), this->end(), keyFn);
+    using Out = Rebind_t<Container, Group>;
+    return Stream<Out>(toContainer<Out>(std::move(table).release()));
+  }
+
+  // (key, reducer-fold of the elements with that key) pairs; a key's first
+  // element seeds its accumulator.
+  template <typename KeyFn, typename Reducer>
+  auto reduceByKey(KeyFn keyFn, Reducer reducer) const {
+    using Key = KeyOf<ValueType, KeyFn>;
+    FlatHashMap<Key, ValueType> table(this->size());
+    reduceInto(table, this->begin(), this->end(), keyFn, reducer);
+    using Out = Rebind_t<Container, std::pair<Key, ValueType>>;
+    return Stream<Out>(toContainer<Out>(std::move(table).release()));
+  }
+
+  // First occurrence of every distinct element.
+  Stream distinct() const {
+    FlatHashMap<ValueType, NoValue> seen(this->size());
+    distinctInto(seen, this->begin(), this->end());
+    return Stream(distinctKeys<Container>(std::move(seen)));
+  }
+
+  // Inner equi-join: (x, y) for every x of this stream and y of other with
+  // leftKey(x) == rightKey(y), in the order of this stream and then other.
+  // other is indexed in a hash table and this stream probes it.
+  template <typename Other, typename LeftKey, typename RightKey>
+  auto hashJoin(const Other &other, LeftKey leftKey, RightKey rightKey) const {
+    using Key = KeyOf<ValueType, LeftKey>;
+    using Row = typename Other::value_type;
+    using Out = Rebind_t<Container, std::pair<ValueType, Row>>;
+    JoinIndex<Key, Row> index(other, rightKey);
+    Out result;
+    for (const auto &item : *this) {
+      index.forEachMatch(leftKey(item), [&](const Row &row) {
+        result.push_back(std::pair<ValueType, Row>(item, row));
+      });
+    }
+    return Stream<Out>(std::move(result));
+  }
+
+  template <typename Other, typename KeyFn>
+  auto hashJoin(const Other &other, KeyFn keyFn) const {
+    return hashJoin(other, keyFn, keyFn);
+  }
+
+  // Ordering operations. Keys are computed once per element and equal
+  // keys keep their source order. Integral and floating-point keys under
+  // std::less<> or std::greater<> are sorted by an LSD radix sort.
+
+  // The elements in compare order of keyFn(element).
+  template <typename KeyFn, typename Compare = std::less<>>
+  Stream sortBy(KeyFn keyFn, Compare compare = Compare()) && {
+    return gather(*this, sortedOrder(*this, keyFn, compare));
+  }
+
+  template <typename KeyFn, typename Compare = std::less<>>
+  Stream sortBy(KeyFn keyFn, Compare compare = Compare()) const & {
+    return gather(*this, sortedOrder(*this, keyFn, compare));
+  }
+
+  // The first k elements of sortBy(keyFn, compare), selected with
+  // nth_element so that only those k are sorted.
+  template <typename KeyFn, typename Compare = std::less<>>
+  Stream topK(std::size_t k, KeyFn keyFn, Compare compare = Compare()) && {
+    return gather(*this, firstOrder(*this, k, keyFn, compare));
+  }
+
+  template <typename KeyFn, typename Compare = std::less<>>
+  Stream topK(std::size_t k, KeyFn keyFn,
+              Compare compare = Compare()) const & {
+    return gather(*this, firstOrder(*this, k, keyFn, compare));
+  }
+
+  // A pipeline over the elements of this stream that borrows its
+  // container rather than copying it.
+  auto view() const & {
+    return FusedStream<const Container &, ValueType, IdentityStage>(
+        container(), IdentityStage{});
+  }
+
+  void view() && = delete;
+
+  ParallelStream<Container> par() && {
+    return ParallelStream<Container>(std::move(container()));
+  }
+
+  ParallelStream<Container> par() const & {
+    return ParallelStream<Container>(Container(container()));
+  }
+
+  EagerStream<Container> eager() && {
+    return EagerStream<Container>(std::move(container()));
+  }
+
+  EagerStream<Container> eager() const & {
+    return EagerStream<Container>(Container(container()));
+  }
+
   Container collect() && { return std::move(static_cast<Container &>(*this)); }
 
   Container collect() const & { return static_cast<Container>(*this); }
+
+  // Copies the elements into another kind of container, such as the
+  // records of an SoA stream into a std::vector.
+  template <typename Out> Out collect() const & {
+    Out result;
+    if constexpr (HasMember_reserve<Out>::value) {
+      result.reserve(this->size());
+    }
+    for (const auto &item : *this) {
+      result.insert(result.end(), item);
+    }
+    return result;
+  }
+
+private:
+  Container &container() { return *this; }
+  const Container &container() const { return *this; }
+
+  // The elements at the given positions, moved out of a mutable stream
+  // and copied out of a const one.
+  template <typename Self>
+  static Stream gather(Self &self, const ArenaVector<std::size_t> &order) {
+    Container result;
+    if constexpr (HasMember_reserve<Container>::value) {
+      result.reserve(order.size());
+    }
+    auto take = [&result](auto &&item) {
+      if constexpr (std::is_const_v<Self>) {
+        append(result, item);
+      } else {
+        append(result, std::move(item));
+      }
+    };
+    using It = decltype(self.begin());
+    if constexpr (std::is_base_of_v<
+                      std::random_access_iterator_tag,
+                      typename std::iterator_traits<It>::iterator_category>) {
+      for (std::size_t i : order)
+        take(self.begin()[i]);
+    } else {
+      ArenaVector<It> at;
+      at.reserve(self.size());
+      for (auto it = self.begin(); it != self.end(); ++it)
+        at.push_back(it);
+      for (std::size_t i : order)
+        take(*at[i]);
+    }
+    return Stream(std::move(result));
+  }
 };
 } // namespace impl
 
@@ -14,7 +14,7 @@ template <template <typename> class F> struct Functor {
   // fmap :: (a -> b) -> f a -> f b
   template <typename A, typename B>
   static F<B> fmap(F<A> fa, std::function<B(A)> f) {
-    return fa.map(f);
+    return std::move(fa).map(f);
   }
 };
 
@@ -31,9 +31,11 @@ template <template <typename> class F> struct Applicative {
         return Maybe<B>();
       }
       return Maybe<B>((*ff)(*fa));
+    } else {
+      // Every function applied to every value, through the monad.
+      return ff.and_then(
+          [&fa](const std::function<B(A)> &f) { return fa.map(f); });
     }
-    // Implementation for other types...
-    return F<B>();
   }
 };
 
@@ -49,10 +51,10 @@ template <template <typename> class F> struct Monad {
       if (!ma.isJust()) {
         return Maybe<B>();
       }
-      return f(*ma);
+      return f(std::move(*ma));
+    } else {
+      return std::move(ma).and_then(f);
     }
-    // Implementation for other types...
-    return F<B>();
   }
 
   // >> :: m a -> m b -> m b
@@ -66,7 +68,7 @@ template <template <typename> class F> struct Monad {
 template <> struct Functor<Maybe> {
   template <typename A, typename B>
   static Maybe<B> fmap(Maybe<A> ma, std::function<B(A)> f) {
-    return ma.map(f);
+    return std::move(ma).map(f);
   }
 };
 
@@ -94,7 +96,7 @@ template <> struct Monad<Maybe> {
     if (!ma.isJust()) {
       return Maybe<B>();
     }
-    return f(*ma);
+    return f(std::move(*ma));
   }
 
   template <typename A, typename B>
@@ -151,7 +153,7 @@ template <template <typename> class F, typename A, typename B,
           typename
           = std::enable_if_t<std::is_invocable_v<std::function<B(A)>, A>>>
 F<B> fmap(F<A> fa, std::function<B(A)> f) {
-  return Functor<F>::fmap(fa, f);
+  return Functor<F>::fmap(std::move(fa), f);
 }
 
 template <template <typename> class F, typename A> F<A> pure(A a) {
@@ -162,7 +164,7 @@ template <template <typename> class F, typename A, typename B,
           typename
           = std::enable_if_t<std::is_invocable_v<std::function<B(A)>, A>>>
 F<B> ap(F<std::function<B(A)>> ff, F<A> fa) {
-  return Applicative<F>::ap(ff, fa);
+  return Applicative<F>::ap(std::move(ff), std::move(fa));
 }
 
 template <template <typename> class F, typename A> F<A> return_(A a) {
@@ -173,12 +175,12 @@ template <template <typename> class F, typename A, typename B,
           typename
           = std::enable_if_t<std::is_invocable_v<std::function<F<B>(A)>, A>>>
 F<B> bind(F<A> ma, std::function<F<B>(A)> f) {
-  return Monad<F>::bind(ma, f);
+  return Monad<F>::bind(std::move(ma), f);
 }
 
 template <template <typename> class F, typename A, typename B>
 F<B> then(F<A> ma, F<B> mb) {
-  return Monad<F>::then(ma, mb);
+  return Monad<F>::then(std::move(ma), std::move(mb));
 }
 
 } // namespace caskell
@@ -2,10 +2,81 @@
 #ifndef CASKELL_UTILS_HPP
 #define CASKELL_UTILS_HPP
 
+#include <cstddef>
+#include <type_traits>
 #include <utility>
 
 namespace caskell {
 
+namespace impl {
+// Container capabilities used when collecting into an arbitrary container.
+template <typename T, typename = void>
+struct HasMember_push_back : std::false_type {};
+
+template <typename T>
+struct HasMember_push_back<T,
+                           std::void_t<decltype(std::declval<T &>().push_back(
+                               std::declval<typename T::value_type>()))>>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct HasMember_insert : std::false_type {};
+
+template <typename T>
+struct HasMember_insert<T, std::void_t<decltype(std::declval<T &>().insert(
+                               std::declval<typename T::iterator>(),
+                               std::declval<typename T::value_type>()))>>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct HasMember_reserve : std::false_type {};
+
+template <typename T>
+struct HasMember_reserve<
+    T, std::void_t<decltype(std::declval<T &>().reserve(std::size_t{}))>>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct HasMember_shrink_to_fit : std::false_type {};
+
+template <typename T>
+struct HasMember_shrink_to_fit<
+    T, std::void_t<decltype(std::declval<T &>().shrink_to_fit(),
+                            std::declval<const T &>().capacity())>>
+    : std::true_type {};
+
+// Contiguous storage, as exposed by std::vector, std::array and strings.
+template <typename T, typename = void>
+struct HasMember_data : std::false_type {};
+
+template <typename T>
+struct HasMember_data<
+    T, std::void_t<decltype(std::declval<const T &>().data())>>
+    : std::true_type {};
+
+// Adds item at the end of a container with push_back or insert.
+template <typename Container, typename T>
+void append(Container &container, T &&item) {
+  if constexpr (HasMember_push_back<Container>::value) {
+    container.push_back(std::forward<T>(item));
+  } else {
+    container.insert(container.end(), std::forward<T>(item));
+  }
+}
+
+// Most elements reserved ahead of a size hint that is only an upper bound,
+// so a selective filter over a huge generated source does not allocate the
+// whole bound.
+inline constexpr std::size_t MaxBoundReserve = 4096;
+
+template <typename Container>
+void reserveBound(Container &container, std::size_t bound) {
+  if constexpr (HasMember_reserve<Container>::value) {
+    container.reserve(bound < MaxBoundReserve ? bound : MaxBoundReserve);
+  }
+}
+} // namespace impl
+
 // Y combinator for recursive lambdas
 template <typename F> struct y_combinator {
   F f;
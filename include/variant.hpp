@@ -52,6 +52,11 @@ public:
         data);
   }
 
+  // Calls f with the held value, whatever its type.
+  template <typename F> decltype(auto) visit(F &&f) const {
+    return std::visit(std::forward<F>(f), data);
+  }
+
 private:
   template <typename T, typename Handler> struct MatchedArm {
     using HandlerArg = std::decay_t<typename impl::FirstArgType<Handler>::type>;
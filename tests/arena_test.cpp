@@ -0,0 +1,112 @@
+#include "arena.hpp"
+#include "common_monads.hpp"
+#include "lazystream.hpp"
+#include "stream.hpp"
+#include <doctest/doctest.h>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+namespace {
+// Upstream resource that counts the blocks the arena requests.
+class CountingResource : public std::pmr::memory_resource {
+public:
+  int allocations = 0;
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t align) override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, align);
+  }
+  void do_deallocate(void *p, std::size_t bytes, std::size_t align) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+  }
+  bool do_is_equal(const memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+} // namespace
+
+TEST_CASE("ArenaScope") {
+  using caskell::ArenaAllocator;
+  using caskell::ArenaScope;
+  using caskell::ArenaList;
+
+  SUBCASE("Allocators capture the innermost open scope") {
+    CHECK(ArenaAllocator<int>().resource() == nullptr);
+    {
+      ArenaScope outer;
+      CHECK(ArenaAllocator<int>().resource() == outer.resource());
+      {
+        ArenaScope inner;
+        CHECK(ArenaAllocator<int>().resource() == inner.resource());
+      }
+      CHECK(ArenaAllocator<int>().resource() == outer.resource());
+    }
+    CHECK(ArenaAllocator<int>().resource() == nullptr);
+  }
+
+  SUBCASE("List operations allocate from the arena") {
+    CountingResource upstream;
+    {
+      ArenaScope scope(1024, &upstream);
+      ArenaList<int> xs{1, 2, 3};
+      auto ys = xs.map([](int x) { return x * 2; })
+                    .and_then([](int x) { return ArenaList<int>{x, x + 1}; });
+      CHECK(ys.get().get_allocator().resource() == scope.resource());
+      CHECK(ys == ArenaList<int>{2, 3, 4, 5, 6, 7});
+      CHECK(caskell::Show<ArenaList<int>>::show(ys) == "[2, 3, 4, 5, 6, 7]");
+    }
+    CHECK(upstream.allocations > 0);
+  }
+
+  SUBCASE("Copies taken after the scope ends outlive it") {
+    ArenaList<int> kept;
+    std::string shown;
+    {
+      ArenaScope scope;
+      auto xs = caskell::range<int, caskell::ArenaStorage>(1, 100).map(
+          [](int x) { return x * x; });
+      kept = xs;
+      shown = caskell::Show<caskell::List<int>>::show(caskell::range(1, 3));
+    }
+    CHECK(kept.get().get_allocator().resource() == nullptr);
+    CHECK(kept.length() == 100);
+    CHECK(kept.last() == 10000);
+    CHECK(shown == "[1, 2, 3]");
+  }
+
+  SUBCASE("Stream and LazyStream intermediates stay in the arena") {
+    ArenaScope scope;
+    caskell::ArenaVector<int> data{1, 2, 3, 4, 5, 6};
+    auto halves = caskell::stream(std::move(data))
+                      .filter([](int x) { return x % 2 == 0; })
+                      .map([](int x) { return x / 2.0; })
+                      .collect();
+    static_assert(std::is_same_v<decltype(halves),
+                                 caskell::ArenaVector<double>>);
+    CHECK(halves.get_allocator().resource() == scope.resource());
+    CHECK(halves == caskell::ArenaVector<double>{1, 2, 3});
+
+    auto squares = caskell::LazyStream(caskell::RangeGenerator<int>(0))
+                       .map([](int x) { return x * x; })
+                       .take(5)
+                       .collect<caskell::ArenaVector<int>>();
+    CHECK(squares.get_allocator().resource() == scope.resource());
+    CHECK(squares == caskell::ArenaVector<int>{0, 1, 4, 9, 16});
+
+    auto groups = caskell::stream(std::vector<int>{1, 2, 3, 4, 5})
+                      .par()
+                      .groupBy([](int x) { return x % 2; })
+                      .collect();
+    REQUIRE(groups.size() == 2);
+    CHECK(groups[0].second == std::vector<int>{1, 3, 5});
+  }
+
+  SUBCASE("Other threads do not see the scope") {
+    ArenaScope scope;
+    std::pmr::memory_resource *seen = scope.resource();
+    std::thread([&seen] { seen = ArenaAllocator<int>().resource(); }).join();
+    CHECK(seen == nullptr);
+  }
+}
@@ -1,6 +1,8 @@
 // #include "maybe.hpp"
 #include "variant.hpp"
+#include <limits>
 #include <string>
+#include <vector>
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 
@@ -63,6 +65,159 @@ TEST_CASE("Maybe") {
   CHECK(result.value_or(-1) == 4);
 }
 
+namespace {
+enum class Port : int { None = -1 };
+struct Handle {
+  int fd;
+};
+} // namespace
+
+template <>
+struct caskell::MaybeTraits<Port> : caskell::MaybeSentinel<Port, Port::None> {
+};
+
+template <> struct caskell::MaybeTraits<Handle> {
+  static constexpr bool HasNiche = true;
+  static Handle nothing() { return Handle{-1}; }
+  static bool isNothing(const Handle &h) { return h.fd == -1; }
+};
+
+TEST_CASE("Maybe layout") {
+  using caskell::Maybe;
+
+  SUBCASE("Types with a niche take no extra space") {
+    CHECK(sizeof(Maybe<double>) == sizeof(double));
+    CHECK(sizeof(Maybe<float>) == sizeof(float));
+    CHECK(sizeof(Maybe<const char *>) == sizeof(const char *));
+    CHECK(sizeof(Maybe<Port>) == sizeof(Port));
+    CHECK(sizeof(Maybe<Handle>) == sizeof(Handle));
+    CHECK(sizeof(Maybe<int>) > sizeof(int));
+  }
+
+  SUBCASE("Every ordinary value is a Just") {
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    CHECK(Maybe<double>(nan).isJust());
+    CHECK(Maybe<double>(-0.0).isJust());
+    CHECK(Maybe<double>().isNothing());
+    CHECK(Maybe<float>(std::numeric_limits<float>::infinity()).isJust());
+    CHECK(Maybe<int *>(nullptr).isJust());
+    CHECK(Maybe<int *>().isNothing());
+    CHECK(Maybe<Port>(Port(80)).isJust());
+    CHECK(Maybe<Port>().isNothing());
+    CHECK(Maybe<Handle>(Handle{3}).isJust());
+    CHECK(Maybe<Handle>().isNothing());
+  }
+
+  SUBCASE("map, and_then and | behave as before") {
+    auto half = [](double x) {
+      return x > 0 ? Maybe<double>(x / 2) : Maybe<double>();
+    };
+    CHECK(*Maybe<double>(3).map([](double x) { return x + 1; }) == 4);
+    CHECK(Maybe<double>().map([](double x) { return x + 1; }).isNothing());
+    CHECK(*Maybe<double>(8).and_then(half).and_then(half) == 2);
+    CHECK((Maybe<double>(-1) | half).isNothing());
+    CHECK(Maybe<double>().value_or(7) == 7);
+    CHECK(Maybe<double>(2.5) == Maybe<double>(2.5));
+    CHECK_FALSE(Maybe<double>() == Maybe<double>(2.5));
+
+    int x = 1;
+    auto ptr = Maybe<int>(5).map([&x](int) { return &x; });
+    CHECK(*ptr == &x);
+    auto null = ptr.map([](int *) -> int * { return nullptr; });
+    CHECK(null.isJust());
+    CHECK(*null == nullptr);
+  }
+}
+
+namespace {
+// A large payload that counts its copies.
+struct Buffer {
+  static inline int copies = 0;
+  std::vector<char> bytes;
+
+  explicit Buffer(std::size_t size) : bytes(size) {}
+  Buffer(const Buffer &other) : bytes(other.bytes) { ++copies; }
+  Buffer(Buffer &&) = default;
+  Buffer &operator=(const Buffer &other) {
+    bytes = other.bytes;
+    ++copies;
+    return *this;
+  }
+  Buffer &operator=(Buffer &&) = default;
+};
+
+Buffer touch(Buffer b) {
+  ++b.bytes[0];
+  return b;
+}
+} // namespace
+
+TEST_CASE("Rvalue map and and_then move the payload") {
+  constexpr std::size_t Size = 1 << 20;
+
+  SUBCASE("Maybe") {
+    Buffer::copies = 0;
+    auto m = caskell::Maybe<Buffer>(Buffer(Size));
+    for (int i = 0; i < 5; ++i) {
+      m = std::move(m).map(touch).and_then(
+          [](Buffer b) { return caskell::Maybe<Buffer>(touch(std::move(b))); });
+    }
+    CHECK((*m).bytes[0] == 10);
+    CHECK(Buffer::copies == 0);
+
+    auto kept = m.map(touch);
+    CHECK(Buffer::copies == 1);
+    CHECK((*m).bytes[0] == 10);
+    CHECK((*kept).bytes[0] == 11);
+  }
+
+  SUBCASE("Identity") {
+    Buffer::copies = 0;
+    auto id = caskell::Identity<Buffer>(Buffer(Size));
+    for (int i = 0; i < 5; ++i) {
+      id = std::move(id).map(touch).and_then([](Buffer b) {
+        return caskell::Identity<Buffer>(touch(std::move(b)));
+      });
+    }
+    CHECK((*id).bytes[0] == 10);
+    CHECK(Buffer::copies == 0);
+  }
+
+  SUBCASE("List") {
+    Buffer::copies = 0;
+    caskell::List<Buffer> xs;
+    xs.get().push_back(Buffer(Size));
+    xs.get().push_back(Buffer(Size));
+    const char *first = xs.get().front().bytes.data();
+    for (int i = 0; i < 5; ++i) {
+      xs = std::move(xs).map(touch).and_then([](Buffer b) {
+        caskell::List<Buffer> ys;
+        ys.get().push_back(touch(std::move(b)));
+        return ys;
+      });
+    }
+    CHECK(xs.length() == 2);
+    CHECK(xs.get().front().bytes[0] == 10);
+    CHECK(xs.get().front().bytes.data() == first);
+    CHECK(Buffer::copies == 0);
+  }
+
+  SUBCASE("Writer") {
+    Buffer::copies = 0;
+    using Writer = caskell::Writer<Buffer>;
+    auto w = Writer(Buffer(Size), "");
+    for (int i = 0; i < 10; ++i) {
+      w = std::move(w).and_then([](Buffer b) {
+        return Writer(touch(std::move(b)), "step;");
+      });
+    }
+    auto [value, log] = std::move(w).run();
+    CHECK(value.bytes[0] == 10);
+    CHECK(log.size() == 50);
+    CHECK(Buffer::copies == 0);
+  }
+}
+
 TEST_CASE("Variant") {
   caskell::Variant<int, std::string> v1(42);
   auto f = [](const auto &v) {
@@ -0,0 +1,524 @@
+#include "coroutine.hpp"
+#include "lazylist.hpp"
+#include "lazystream.hpp"
+#include "mapped_file.hpp"
+#include <doctest/doctest.h>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+// A user-defined generator without the optional batch protocol.
+class CountdownGenerator;
+} // namespace
+
+template <> struct caskell::impl::GeneratorTraits<CountdownGenerator> {
+  using ValueType = int;
+};
+
+namespace {
+class CountdownGenerator : public caskell::Generator<CountdownGenerator> {
+  mutable int current_;
+
+public:
+  using ValueType = int;
+  explicit CountdownGenerator(int start) : current_(start) {}
+  std::optional<int> nextImpl() const {
+    if (current_ == 0)
+      return std::nullopt;
+    return current_--;
+  }
+};
+} // namespace
+
+TEST_CASE("Lazy Stream batching") {
+  SUBCASE("Batched chains match element-wise results") {
+    auto stream = caskell::LazyStream(caskell::RangeGenerator<int>(0))
+                      .map([](int x) { return x * 3; })
+                      .filter([](int x) { return x % 2 == 0; })
+                      .take(1000);
+    using Gen = decltype(stream)::GeneratorType;
+    static_assert(caskell::impl::IsBatchable<Gen>::value);
+    auto result = stream.collect<std::vector<int>>();
+    REQUIRE(result.size() == 1000);
+    for (std::size_t i = 0; i < result.size(); ++i)
+      CHECK(result[i] == static_cast<int>(i) * 6);
+  }
+
+  SUBCASE("Take does not over-consume the source") {
+    std::vector<int> vec(1000);
+    std::iota(vec.begin(), vec.end(), 0);
+    int calls = 0;
+    auto sum = caskell::LazyStream(caskell::ContainerGenerator(vec))
+                   .map([&calls](int x) {
+                     ++calls;
+                     return x;
+                   })
+                   .take(300)
+                   .reduce(0, [](int a, int b) { return a + b; });
+    CHECK(sum == 299 * 300 / 2);
+    CHECK(calls == 300);
+  }
+
+  SUBCASE("Generators without nextBatch fall back to next()") {
+    static_assert(!caskell::impl::IsBatchable<CountdownGenerator>::value);
+    auto sum = caskell::LazyStream(CountdownGenerator(10))
+                   .map([](int x) { return x * 2; })
+                   .reduce(0, [](int a, int b) { return a + b; });
+    CHECK(sum == 110);
+  }
+
+  SUBCASE("Non-trivial element types fall back to next()") {
+    std::vector<std::string> words = {"a", "bb", "ccc"};
+    using Gen = decltype(caskell::ContainerGenerator(words));
+    static_assert(!caskell::impl::IsBatchable<Gen>::value);
+    auto joined = caskell::LazyStream(caskell::ContainerGenerator(words))
+                      .reduce(std::string(), [](std::string a,
+                                                const std::string &b) {
+                        return a + b;
+                      });
+    CHECK(joined == "abbccc");
+  }
+}
+
+TEST_CASE("Lazy Stream push execution") {
+  SUBCASE("Take stops an infinite source") {
+    int pulled = 0;
+    auto words = caskell::LazyStream(caskell::RangeGenerator<int>(1))
+                     .map([&pulled](int x) {
+                       ++pulled;
+                       return std::string(static_cast<std::size_t>(x), '*');
+                     })
+                     .filter([](const std::string &s) { return s.size() > 2; })
+                     .take(3)
+                     .collect<std::vector<std::string>>();
+    REQUIRE(words.size() == 3);
+    CHECK(words[0] == "***");
+    CHECK(words[2] == "*****");
+    CHECK(pulled == 5);
+  }
+
+  SUBCASE("Stop requests propagate out of nested stages") {
+    std::vector<std::string> words = {"x", "yy", "zzz", "w"};
+    auto gen = caskell::FilterGenerator(caskell::ContainerGenerator(words),
+                                        [](const std::string &s) {
+                                          return s.size() > 1;
+                                        });
+    std::vector<std::string> seen;
+    bool completed = gen.push([&seen](const std::string &s) {
+      seen.push_back(s);
+      return false;
+    });
+    CHECK_FALSE(completed);
+    REQUIRE(seen.size() == 1);
+    CHECK(seen[0] == "yy");
+  }
+
+  SUBCASE("Generators without pushImpl are adapted") {
+    int count = 0;
+    bool completed = CountdownGenerator(4).push([&count](int) {
+      ++count;
+      return true;
+    });
+    CHECK(completed);
+    CHECK(count == 4);
+  }
+}
+
+TEST_CASE("Lazy Stream parallel operations") {
+  std::vector<long long> vec(100000);
+  std::iota(vec.begin(), vec.end(), 0);
+  auto pipeline = caskell::LazyStream(caskell::ContainerGenerator(vec))
+                      .map([](long long x) { return x * 2; })
+                      .filter([](long long x) { return x % 3 == 0; });
+
+  SUBCASE("parallelReduce matches reduce") {
+    auto add = [](long long a, long long b) { return a + b; };
+    CHECK(pipeline.parallelReduce(0LL, add) == pipeline.reduce(0LL, add));
+  }
+
+  SUBCASE("parallelCollect keeps source order") {
+    auto parallel = pipeline.parallelCollect<std::vector<long long>>();
+    CHECK(parallel == pipeline.collect<std::vector<long long>>());
+  }
+
+  SUBCASE("parallelForEach visits every element") {
+    std::atomic<long long> sum{0};
+    pipeline.parallelForEach([&sum](long long x) { sum += x; });
+    CHECK(sum == pipeline.reduce(0LL, std::plus<>()));
+  }
+
+  SUBCASE("enumerate splits only where it numbers source positions") {
+    using Numbered = decltype(pipeline.enumerate())::GeneratorType;
+    static_assert(!caskell::impl::IsSplittable<Numbered>::value);
+    using Pair = std::pair<std::size_t, long long>;
+    auto numbered = caskell::LazyStream(caskell::ContainerGenerator(vec))
+                        .enumerate()
+                        .filter([](const Pair &p) {
+                          return p.second % 3 == 0;
+                        });
+    CHECK(numbered.parallelCollect<std::vector<Pair>>()
+          == numbered.collect<std::vector<Pair>>());
+    auto evens = pipeline.enumerate().collect<std::vector<Pair>>();
+    REQUIRE(evens.size() > 2);
+    CHECK(evens[2] == Pair{2, 12});
+  }
+
+  SUBCASE("take() bounds a range into a splittable source") {
+    auto count = caskell::LazyStream(caskell::RangeGenerator<long long>(1))
+                     .map([](long long x) { return x * x; })
+                     .take(50000)
+                     .parallelReduce(
+                         std::size_t{0},
+                         [](std::size_t n, long long) { return n + 1; },
+                         std::plus<>());
+    CHECK(count == 50000);
+  }
+
+  SUBCASE("Thread pool runs every task once") {
+    caskell::impl::ThreadPool pool(3);
+    std::vector<int> hits(64);
+    pool.run(hits.size(), [&hits](std::size_t i) { ++hits[i]; });
+    CHECK(std::all_of(hits.begin(), hits.end(),
+                      [](int h) { return h == 1; }));
+    CHECK_THROWS(pool.run(8, [](std::size_t i) {
+      if (i == 5)
+        throw std::runtime_error("task failed");
+    }));
+  }
+}
+
+TEST_CASE("Lazy Stream size hints") {
+  using caskell::impl::SizeKind;
+  using caskell::impl::SizeKindOf;
+  std::vector<int> vec(1000, 1);
+
+  SUBCASE("Hints propagate through the chain") {
+    auto mapped = caskell::LazyStream(caskell::ContainerGenerator(vec))
+                      .map([](int x) { return x + 1; });
+    using Mapped = decltype(mapped)::GeneratorType;
+    static_assert(SizeKindOf<Mapped>::value == SizeKind::Exact);
+
+    auto filtered = mapped.filter([](int x) { return x > 1; });
+    using Filtered = decltype(filtered)::GeneratorType;
+    static_assert(SizeKindOf<Filtered>::value == SizeKind::UpperBound);
+
+    auto taken = caskell::LazyStream(caskell::RangeGenerator<int>(0)).take(7);
+    using Taken = decltype(taken)::GeneratorType;
+    static_assert(SizeKindOf<Taken>::value == SizeKind::Exact);
+    CHECK(caskell::TakeGenerator(caskell::ContainerGenerator(vec), 2000)
+              .sizeHint()
+          == 1000);
+  }
+
+  SUBCASE("collect reserves from the hint") {
+    auto result = caskell::LazyStream(caskell::ContainerGenerator(vec))
+                      .map([](int x) { return x * 2; })
+                      .collect<std::vector<int>>();
+    CHECK(result.size() == 1000);
+    CHECK(result.capacity() == 1000);
+  }
+
+  SUBCASE("An upper bound only seeds a capped reservation") {
+    auto rare = caskell::LazyStream(caskell::RangeGenerator<int>(0))
+                    .take(1'000'000)
+                    .filter([](int x) { return x % 250'000 == 0; })
+                    .collect<std::vector<int>>();
+    CHECK(rare == std::vector<int>{0, 250'000, 500'000, 750'000});
+    CHECK(rare.capacity() <= caskell::impl::MaxBoundReserve);
+  }
+}
+
+TEST_CASE("Lazy Stream combinators") {
+  std::vector<int> vec = {3, 1, 4, 1, 5, 9, 2, 6};
+  auto source = caskell::LazyStream(caskell::ContainerGenerator(vec));
+  auto naturals = caskell::LazyStream(caskell::RangeGenerator<int>(0));
+
+  SUBCASE("zip and enumerate") {
+    auto zipped = source.zip(naturals.map([](int x) { return x * 10; }))
+                      .collect<std::vector<std::pair<int, int>>>();
+    REQUIRE(zipped.size() == vec.size());
+    CHECK(zipped[2] == std::make_pair(4, 20));
+
+    auto indexed = source.enumerate().take(3).collect<
+        std::vector<std::pair<std::size_t, int>>>();
+    REQUIRE(indexed.size() == 3);
+    CHECK(indexed[2] == std::make_pair(std::size_t{2}, 4));
+  }
+
+  SUBCASE("topK keeps the first k by key") {
+    CHECK(source.topK(3, [](int x) { return x; })
+          == std::vector<int>{1, 1, 2});
+    CHECK(source.topK(2, [](int x) { return x; }, std::greater<>())
+          == std::vector<int>{9, 6});
+    auto nearest = naturals.take(10000).topK(
+        4, [](int x) { return (x - 5000) * (x - 5000); });
+    CHECK(nearest == std::vector<int>{5000, 4999, 5001, 4998});
+    CHECK(source.topK(0, [](int x) { return x; }).empty());
+  }
+
+  SUBCASE("flatMap splices inner streams") {
+    auto repeated = naturals.take(4)
+                        .flatMap([](int x) {
+                          return caskell::LazyStream(
+                                     caskell::RangeGenerator<int>(0))
+                              .take(static_cast<std::size_t>(x));
+                        })
+                        .collect<std::vector<int>>();
+    CHECK(repeated == std::vector<int>{0, 0, 1, 0, 1, 2});
+
+    auto firstTwo = naturals.flatMap([](int x) {
+                              return caskell::TakeGenerator(
+                                  caskell::RangeGenerator<int>(x), 2);
+                            })
+                        .take(5)
+                        .collect<std::vector<int>>();
+    CHECK(firstTwo == std::vector<int>{0, 1, 1, 2, 2});
+  }
+
+  SUBCASE("scan yields running totals") {
+    auto sums = source.scan(0, std::plus<>()).collect<std::vector<int>>();
+    CHECK(sums == std::vector<int>{3, 4, 8, 9, 14, 23, 25, 31});
+  }
+
+  SUBCASE("takeWhile and dropWhile") {
+    auto small = naturals.takeWhile([](int x) { return x < 4; })
+                     .collect<std::vector<int>>();
+    CHECK(small == std::vector<int>{0, 1, 2, 3});
+
+    auto tail = source.dropWhile([](int x) { return x < 5; })
+                    .collect<std::vector<int>>();
+    CHECK(tail == std::vector<int>{5, 9, 2, 6});
+
+    auto pulled = source.dropWhile([](int x) { return x < 5; });
+    auto it = pulled.begin();
+    CHECK(*it == 5);
+  }
+
+  SUBCASE("chunk groups fixed-size blocks") {
+    using Chunk = caskell::Chunk<int, 3>;
+    auto chunks = source.chunk<3>().collect<std::vector<Chunk>>();
+    REQUIRE(chunks.size() == 3);
+    CHECK(chunks[1].size() == 3);
+    CHECK(chunks[1][0] == 1);
+    CHECK(chunks[2].size() == 2);
+    CHECK(chunks[2][1] == 6);
+    CHECK(source.chunk<3>().generator().sizeHint() == 3);
+  }
+}
+
+TEST_CASE("Lazy Stream iteration") {
+  std::vector<int> vec = {5, 8, 13, 21, 34, 55};
+  auto odd = caskell::LazyStream(caskell::ContainerGenerator(vec))
+                 .filter([](int x) { return x % 2 != 0; });
+
+  SUBCASE("Iterators satisfy the standard requirements") {
+    using It = decltype(odd.begin());
+    static_assert(std::is_same_v<std::iterator_traits<It>::iterator_category,
+                                 std::input_iterator_tag>);
+    static_assert(std::is_same_v<std::iterator_traits<It>::value_type, int>);
+    static_assert(std::is_copy_assignable_v<It>);
+    CHECK(std::count_if(odd.begin(), odd.end(),
+                        [](int x) { return x > 10; })
+          == 3);
+    CHECK(*std::find(odd.begin(), odd.end(), 21) == 21);
+    CHECK(std::accumulate(odd.begin(), odd.end(), 0) == 5 + 13 + 21 + 55);
+  }
+
+  SUBCASE("Elements are referenced in place") {
+    auto it = odd.begin();
+    CHECK(&*it == &vec[0]);
+    ++it;
+    CHECK(&*it == &vec[2]);
+  }
+
+  SUBCASE("Iterator copies share one cursor") {
+    auto squares = caskell::LazyStream(caskell::RangeGenerator<int>(2))
+                       .map([](int x) { return x * x; });
+    auto it = squares.begin();
+    auto copy = it;
+    CHECK(*it++ == 4);
+    CHECK(*copy == 9);
+    CHECK(it == copy);
+  }
+
+  SUBCASE("Each begin() has its own cursor") {
+    std::vector<std::pair<int, int>> pairs;
+    for (int a : odd)
+      for (int b : odd)
+        pairs.emplace_back(a, b);
+    CHECK(pairs.size() == 16);
+    CHECK(std::equal(odd.begin(), odd.end(), odd.begin()));
+
+    auto local = odd;
+    auto it = local.begin();
+    auto moved = std::move(local);
+    CHECK(*++it == 13);
+    CHECK(*moved.begin() == 5);
+  }
+
+  SUBCASE("Every loop starts from the beginning") {
+    std::vector<int> first(odd.begin(), odd.end());
+    std::vector<int> second(odd.begin(), odd.end());
+    CHECK(first == second);
+    CHECK(first.size() == 4);
+  }
+
+  SUBCASE("Computed elements are held by the iterator") {
+    std::vector<int> squares;
+    for (const int &x : caskell::LazyStream(caskell::RangeGenerator<int>(1))
+                            .map([](int x) { return x * x; })
+                            .take(4))
+      squares.push_back(x);
+    CHECK(squares == std::vector<int>{1, 4, 9, 16});
+  }
+}
+
+TEST_CASE("LazyList") {
+  SUBCASE("Self-referential definitions are memoized") {
+    int calls = 0;
+    auto fibs = caskell::LazyList<long long>::generate(
+        [&calls](const caskell::LazyList<long long> &self, std::size_t i) {
+          ++calls;
+          return i < 2 ? static_cast<long long>(i) : self[i - 1] + self[i - 2];
+        });
+    CHECK(fibs[90] == 2880067194370816120LL);
+    CHECK(calls == 91);
+
+    auto shared = fibs.tail().tail();
+    CHECK(shared.head() == 1);
+    CHECK(shared[88] == fibs[90]);
+    CHECK(calls == 91);
+    CHECK(fibs.forced() == 91);
+  }
+
+  SUBCASE("Finite producers end the list") {
+    using List = caskell::LazyList<int>;
+    auto squares = List::generate(
+        [](const List &, std::size_t i) -> std::optional<int> {
+          if (i == 4)
+            return std::nullopt;
+          return static_cast<int>(i * i);
+        });
+    CHECK(std::vector<int>(squares.begin(), squares.end())
+          == std::vector<int>{0, 1, 4, 9});
+    CHECK(squares.tail().tail().tail().tail().null());
+    CHECK_THROWS_AS(squares.at(4), std::out_of_range);
+  }
+
+  SUBCASE("Interoperates with LazyStream") {
+    int pulled = 0;
+    auto evens = caskell::memoize(
+        caskell::LazyStream(caskell::RangeGenerator<int>(0))
+            .map([&pulled](int x) {
+              ++pulled;
+              return x * 2;
+            }));
+    auto first = evens.stream().take(5).collect<std::vector<int>>();
+    auto again = evens.stream().take(5).reduce(0, std::plus<>());
+    CHECK(first == std::vector<int>{0, 2, 4, 6, 8});
+    CHECK(again == 20);
+    CHECK(pulled == 5);
+  }
+}
+
+namespace {
+// A file in the temporary directory, removed on scope exit. The name holds
+// the process id and a counter, so concurrent test runs do not collide.
+class TempFile {
+  std::string path_;
+
+public:
+  explicit TempFile(std::string_view contents) {
+    static std::atomic<unsigned> counter{0};
+    std::string name = "caskell_test_" + std::to_string(::getpid()) + "_"
+                       + std::to_string(counter++) + ".txt";
+    path_ = (std::filesystem::temp_directory_path() / name).string();
+    std::ofstream out(path_, std::ios::binary);
+    out << contents;
+  }
+
+  TempFile(const TempFile &) = delete;
+  TempFile &operator=(const TempFile &) = delete;
+  ~TempFile() { std::remove(path_.c_str()); }
+
+  const std::string &path() const { return path_; }
+};
+} // namespace
+
+TEST_CASE("Mapped file generator") {
+  TempFile temp("alpha\nbeta\n\ngamma\ndelta");
+  const std::string &path = temp.path();
+  caskell::MappedFile file(path);
+  std::vector<std::string_view> expected = {"alpha", "beta", "", "gamma",
+                                            "delta"};
+
+  SUBCASE("Lines are views into the mapping") {
+    auto lines = caskell::LazyStream(file.lines())
+                     .collect<std::vector<std::string_view>>();
+    CHECK(lines == expected);
+  }
+
+  SUBCASE("Fixed-size records") {
+    auto records = caskell::LazyStream(file.records(4))
+                       .collect<std::vector<std::string_view>>();
+    REQUIRE(records.size() == 5);
+    CHECK(records[0] == "alph");
+    CHECK(records[4] == "a\nde");
+  }
+
+  SUBCASE("Splits are aligned to line starts") {
+    auto gen = file.lines();
+    std::size_t size = gen.splitSize();
+    for (std::size_t cut = 0; cut <= size; ++cut) {
+      auto head = caskell::LazyStream(gen.slice(0, cut))
+                      .collect<std::vector<std::string_view>>();
+      auto rest = caskell::LazyStream(gen.slice(cut, size - cut))
+                      .collect<std::vector<std::string_view>>();
+      head.insert(head.end(), rest.begin(), rest.end());
+      CHECK(head == expected);
+    }
+  }
+
+  CHECK_THROWS_AS(caskell::MappedFile(path + ".missing"), std::system_error);
+}
+
+#ifdef __cpp_impl_coroutine
+namespace {
+caskell::Coroutine<int> countTo(int n) {
+  for (int i = 1; i <= n; ++i)
+    co_yield i;
+}
+} // namespace
+
+TEST_CASE("Coroutine generator") {
+  auto squares = caskell::LazyStream(caskell::CoroutineGenerator<int>(
+                                         [] { return countTo(10); }))
+                     .map([](int x) { return x * x; })
+                     .filter([](int x) { return x % 2 == 0; });
+  CHECK(squares.collect<std::vector<int>>()
+        == std::vector<int>{4, 16, 36, 64, 100});
+  CHECK(squares.take(2).reduce(0, std::plus<>()) == 20);
+
+  std::vector<int> firsts;
+  for (int x : squares)
+    firsts.push_back(x);
+  CHECK(firsts.size() == 5);
+
+  // Short-lived coroutines recycle their frames through the pool.
+  for (int i = 0; i < 1000; ++i)
+    caskell::LazyStream(
+        caskell::CoroutineGenerator<int>([] { return countTo(3); }))
+        .forEach([](int) {});
+  CHECK(caskell::impl::FramePool::local().cached() >= 1);
+}
+#endif
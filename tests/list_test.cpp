@@ -0,0 +1,291 @@
+#include "common_monads.hpp"
+#include "maybe.hpp"
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <numeric>
+#include <string>
+
+TEST_CASE("List storage policies") {
+  using caskell::ConsList;
+  using caskell::List;
+
+  SUBCASE("Both storages behave as the same list") {
+    List<int> deque{1, 2, 3, 4};
+    ConsList<int> cons{1, 2, 3, 4};
+    CHECK(cons.head() == deque.head());
+    CHECK(cons.last() == deque.last());
+    CHECK(cons.length() == 4);
+    CHECK(cons.tail() == ConsList<int>{2, 3, 4});
+    CHECK(cons.init() == ConsList<int>{1, 2, 3});
+    CHECK((0 | cons) == ConsList<int>{0, 1, 2, 3, 4});
+    CHECK(cons + ConsList<int>{5} == ConsList<int>{1, 2, 3, 4, 5});
+    CHECK(caskell::range<int, caskell::ConsStorage>(1, 3)
+          == ConsList<int>{1, 2, 3});
+    auto pairs = cons.from([](int x) { return ConsList<int>{x, -x}; });
+    CHECK(pairs.length() == 8);
+    CHECK(pairs.map([](int x) { return x * x; }).last() == 16);
+    CHECK(caskell::Show<ConsList<int>>::show(cons) == "[1, 2, 3, 4]");
+    CHECK(ConsList<int>().tail().null());
+  }
+
+  SUBCASE("The default list exposes a plain std::deque") {
+    List<int> xs{1, 2};
+    std::deque<int> &values = xs.get();
+    values.push_back(3);
+    CHECK(xs == List<int>{1, 2, 3});
+  }
+
+  SUBCASE("Cons lists share their cells") {
+    ConsList<std::string> xs{"b", "c"};
+    auto ys = ConsList<std::string>::cons("a", xs);
+    CHECK(&*ys.tail().begin() == &*xs.begin());
+    auto zs = ys + xs;
+    CHECK(zs.length() == 5);
+    CHECK(&*std::next(zs.begin(), 3) == &*xs.begin());
+    CHECK(xs == ConsList<std::string>{"b", "c"});
+  }
+
+  SUBCASE("Recursion over tail and destruction of long lists") {
+    ConsList<int> xs;
+    for (int i = 0; i < 200000; ++i)
+      xs = i | xs;
+    long sum = 0;
+    for (auto rest = xs; !rest.null(); rest = rest.tail())
+      sum += rest.head();
+    CHECK(sum == 199999L * 200000 / 2);
+  }
+
+  SUBCASE("Typeclass instances work for either storage") {
+    std::function<int(int)> twice = [](int x) { return 2 * x; };
+    auto doubled = caskell::Functor<ConsList>::fmap(ConsList<int>{1, 2}, twice);
+    CHECK(doubled == ConsList<int>{2, 4});
+    std::function<ConsList<int>(int)> dup = [](int x) {
+      return ConsList<int>{x, x};
+    };
+    CHECK(caskell::Monad<ConsList>::bind(ConsList<int>{1, 2}, dup)
+          == ConsList<int>{1, 1, 2, 2});
+    CHECK(caskell::Monad<caskell::DequeList>::bind(
+              List<int>{3}, std::function<List<int>(int)>([](int x) {
+                return List<int>{x, x + 1};
+              }))
+          == List<int>{3, 4});
+  }
+
+  SUBCASE("Small lists keep their elements in place") {
+    using caskell::SmallList;
+    auto inPlace = [](const auto &list) {
+      auto *begin = reinterpret_cast<const char *>(&list);
+      auto *data = reinterpret_cast<const char *>(list.get().data());
+      return data >= begin && data < begin + sizeof list;
+    };
+
+    SmallList<std::string> empty;
+    auto one = caskell::return_list<std::string, caskell::SmallStorage<2>>(
+        "one");
+    SmallList<std::string> two{"one", "two"};
+    CHECK(inPlace(empty));
+    CHECK(inPlace(one));
+    CHECK(inPlace(two));
+    CHECK(one.head() == "one");
+
+    auto three = "zero" | two;
+    CHECK_FALSE(inPlace(three));
+    CHECK(three == SmallList<std::string>{"zero", "one", "two"});
+    CHECK(three.tail() == two);
+    CHECK(three.init() == SmallList<std::string>{"zero", "one"});
+    CHECK(two + three + one
+          == SmallList<std::string>{"one", "two", "zero", "one", "two",
+                                    "one"});
+
+    auto moved = std::move(three);
+    CHECK(moved.length() == 3);
+    CHECK(three.null());
+    auto movedTwo = std::move(two);
+    CHECK(inPlace(movedTwo));
+    CHECK(movedTwo.last() == "two");
+    moved = movedTwo;
+    CHECK(moved == movedTwo);
+    CHECK(SmallList<int>{1, 2, 3}.and_then([](int x) {
+      return SmallList<int>{x, x};
+    }) == SmallList<int>{1, 1, 2, 2, 3, 3});
+  }
+}
+
+TEST_CASE("Finger tree lists") {
+  using caskell::FingerList;
+
+  auto model = [](const FingerList<int> &xs) {
+    return std::deque<int>(xs.begin(), xs.end());
+  };
+  auto iota = [](int from, int to) {
+    FingerList<int> xs;
+    for (int i = from; i < to; ++i)
+      xs = FingerList<int>::snoc(xs, i);
+    return xs;
+  };
+
+  SUBCASE("Agrees with a deque under every operation") {
+    for (int n : {0, 1, 2, 5, 9, 30, 100, 1000}) {
+      auto xs = iota(0, n);
+      std::deque<int> expected(n);
+      std::iota(expected.begin(), expected.end(), 0);
+      REQUIRE(model(xs) == expected);
+      CHECK(xs.length() == static_cast<size_t>(n));
+
+      bool indexed = true;
+      for (int i = 0; i < n; ++i)
+        indexed = indexed && xs[i] == i;
+      CHECK(indexed);
+
+      bool split = true;
+      for (int k = 0; k <= n + 1; k += 1 + n / 17) {
+        auto [front, back] = xs.splitAt(k);
+        split = split && front.length() == std::min<size_t>(k, n)
+                && front + back == xs;
+      }
+      CHECK(split);
+
+      if (n > 0) {
+        CHECK(xs.head() == 0);
+        CHECK(xs.last() == n - 1);
+        expected.pop_front();
+        CHECK(model(xs.tail()) == expected);
+        if (n > 1) {
+          expected.pop_back();
+          CHECK(model(xs.tail().init()) == expected);
+        }
+      }
+    }
+  }
+
+  SUBCASE("Concatenation of lists of all shapes") {
+    bool equal = true;
+    for (int a : {0, 1, 3, 8, 13, 40}) {
+      for (int b : {0, 1, 2, 7, 20, 64}) {
+        auto xs = iota(0, a) + iota(a, a + b);
+        equal = equal && xs == iota(0, a + b) && xs.length() == size_t(a + b);
+        for (int i = 0; i < a + b; ++i)
+          equal = equal && xs[i] == i;
+      }
+    }
+    CHECK(equal);
+  }
+
+  SUBCASE("Left-nested appends and cons stay consistent") {
+    FingerList<int> xs;
+    for (int i = 0; i < 500; ++i)
+      xs = xs + FingerList<int>{2 * i, 2 * i + 1};
+    for (int i = 1; i <= 10; ++i)
+      xs = -i | xs;
+    CHECK(xs.length() == 1010);
+    CHECK(xs.head() == -10);
+    CHECK(xs[10] == 0);
+    CHECK(xs.last() == 999);
+    auto [front, back] = xs.splitAt(505);
+    CHECK(front.last() == 494);
+    CHECK(back.head() == 495);
+  }
+
+  SUBCASE("Versions are persistent") {
+    auto xs = iota(0, 50);
+    auto ys = 100 | xs;
+    auto zs = FingerList<int>::snoc(xs, 200);
+    CHECK(xs == iota(0, 50));
+    CHECK(ys.head() == 100);
+    CHECK(zs.last() == 200);
+    CHECK(ys.tail() == zs.init());
+  }
+
+  SUBCASE("Works as a Writer log") {
+    using Log = FingerList<std::string>;
+    auto step = [](int x) {
+      return caskell::Writer<int, Log>(x + 1, Log{std::to_string(x)});
+    };
+    caskell::Writer<int, Log> w(0, Log());
+    for (int i = 0; i < 100; ++i)
+      w = w.and_then(step);
+    auto [value, log] = w.run();
+    CHECK(value == 100);
+    CHECK(log.length() == 100);
+    CHECK(log[42] == "42");
+  }
+
+  SUBCASE("Typeclass instances and comprehensions") {
+    std::function<int(int)> twice = [](int x) { return 2 * x; };
+    CHECK(caskell::Functor<FingerList>::fmap(FingerList<int>{1, 2}, twice)
+          == FingerList<int>{2, 4});
+    FingerList<int> pairs
+        = FingerList<int>{1, 2}.lazyFrom([](int x) {
+            return FingerList<int>{x, -x};
+          });
+    CHECK(pairs == FingerList<int>{1, -1, 2, -2});
+  }
+}
+
+TEST_CASE("List comprehensions") {
+  using caskell::ConsList;
+  using caskell::List;
+
+  const List<int> xs{1, 2, 3};
+  auto pairs = [](const auto &list) {
+    return list.from([&list](int x) {
+      return list.from([x](int y) { return List<int>{x * 10 + y}; });
+    });
+  };
+
+  SUBCASE("lazyFrom yields what from yields") {
+    List<int> lazy = xs.lazyFrom([&xs](int x) {
+                         return xs.lazyFrom(
+                             [x](int y) { return List<int>{x * 10 + y}; });
+                       })
+                         .toList();
+    CHECK(lazy == pairs(xs));
+    CHECK(lazy.length() == 9);
+  }
+
+  SUBCASE("Generators may return Maybe") {
+    auto evens = xs.from([](int x) {
+      return x % 2 == 0 ? caskell::pure(x) : caskell::nothing<int>();
+    });
+    CHECK(evens == List<int>{2});
+
+    List<int> lazyEvens = xs.lazyFrom([](int x) {
+      return x % 2 == 0 ? caskell::pure(x) : caskell::nothing<int>();
+    });
+    CHECK(lazyEvens == List<int>{2});
+  }
+
+  SUBCASE("map and filter fuse into the comprehension") {
+    auto result = xs.lazyFrom([](int x) { return List<int>{x, -x}; })
+                      .filter([](int x) { return x > 0; })
+                      .map([](int x) { return std::to_string(x); })
+                      .toList();
+    CHECK(result == List<std::string>{"1", "2", "3"});
+  }
+
+  SUBCASE("Nothing runs before the result is requested") {
+    int calls = 0;
+    auto pending = xs.lazyFrom([&calls](int x) {
+      ++calls;
+      return List<int>{x};
+    });
+    CHECK(calls == 0);
+    CHECK(pending.toList() == xs);
+    CHECK(calls == 3);
+  }
+
+  SUBCASE("A comprehension over a temporary owns it") {
+    auto pending = List<int>{4, 5}.lazyFrom(
+        [](int x) { return List<int>{x, x}; });
+    CHECK(pending.toList() == List<int>{4, 4, 5, 5});
+  }
+
+  SUBCASE("The result keeps the source's storage") {
+    const ConsList<int> cons{1, 2};
+    ConsList<int> doubled
+        = cons.lazyFrom([](int x) { return ConsList<int>{x, x}; });
+    CHECK(doubled == ConsList<int>{1, 1, 2, 2});
+  }
+}
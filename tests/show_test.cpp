@@ -0,0 +1,89 @@
+#include "common_monads.hpp"
+#include "show.hpp"
+#include <doctest/doctest.h>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+
+namespace {
+// A user type with only show(), as Show instances were written before
+// showTo existed.
+struct Point {
+  int x;
+  int y;
+};
+} // namespace
+
+template <> struct caskell::Show<Point> {
+  static std::string show(const Point &p) {
+    return "<" + std::to_string(p.x) + "," + std::to_string(p.y) + ">";
+  }
+};
+
+TEST_CASE("Show") {
+  using caskell::List;
+  using caskell::Show;
+
+  SUBCASE("Numbers print as std::to_string does") {
+    CHECK(Show<int>::show(0) == "0");
+    CHECK(Show<int>::show(-42) == "-42");
+    CHECK(Show<int>::show(std::numeric_limits<int>::min())
+          == std::to_string(std::numeric_limits<int>::min()));
+    CHECK(Show<unsigned long long>::show(
+              std::numeric_limits<unsigned long long>::max())
+          == std::to_string(std::numeric_limits<unsigned long long>::max()));
+    CHECK(Show<double>::show(3.14) == std::to_string(3.14));
+    CHECK(Show<double>::show(-1e300) == std::to_string(-1e300));
+    CHECK(Show<float>::show(0.5f) == "0.500000");
+  }
+
+  SUBCASE("Sizes are exact for integers and strings") {
+    for (long x : {0L, 7L, -7L, 10L, -10L, 99999L, -100000L}) {
+      CHECK(caskell::impl::shownSize(x) == std::to_string(x).size());
+    }
+    List<List<int>> xss{{1, -20}, {}, {300}};
+    CHECK(Show<List<List<int>>>::show(xss) == "[[1, -20], [], [300]]");
+    CHECK(caskell::impl::shownSize(xss) == 21);
+    CHECK(caskell::impl::shownSize(std::string("ab")) == 4);
+  }
+
+  SUBCASE("Monads, tuples and variants") {
+    CHECK(Show<caskell::Maybe<int>>::show(caskell::pure(3)) == "Just(3)");
+    CHECK(Show<caskell::Maybe<int>>::show(caskell::nothing<int>())
+          == "Nothing");
+    CHECK(Show<caskell::Identity<std::string>>::show(
+              caskell::Identity<std::string>("x"))
+          == "Identity(\"x\")");
+    CHECK(Show<caskell::Writer<int>>::show(caskell::Writer<int>(1, "log"))
+          == "Writer(1, \"log\")");
+    CHECK(caskell::impl::shownSize(caskell::Writer<int>(1, "log")) == 16);
+    CHECK(Show<std::tuple<int, std::string, double>>::show(
+              std::make_tuple(1, std::string("a"), 0.25))
+          == "(1, \"a\", 0.250000)");
+    CHECK(Show<std::tuple<>>::show(std::tuple<>()) == "()");
+    CHECK(Show<std::pair<int, List<int>>>::show({1, List<int>{2, 3}})
+          == "(1, [2, 3])");
+    using Number = caskell::Variant<int, std::string>;
+    CHECK(Show<Number>::show(Number(5)) == "5");
+    CHECK(Show<Number>::show(Number(std::string("five"))) == "\"five\"");
+  }
+
+  SUBCASE("Instances with only show() still compose") {
+    List<Point> points{{1, 2}, {3, 4}};
+    CHECK(Show<List<Point>>::show(points) == "[<1,2>, <3,4>]");
+    CHECK(Show<caskell::Maybe<Point>>::show(caskell::pure(Point{0, 0}))
+          == "Just(<0,0>)");
+  }
+
+  SUBCASE("showTo appends to a buffer or a stream") {
+    std::string buffer = "xs = ";
+    caskell::showTo(List<int>{1, 2}, buffer) += ";";
+    CHECK(buffer == "xs = [1, 2];");
+
+    std::ostringstream stream;
+    caskell::showTo(caskell::pure(List<std::string>{"a"}), stream) << "!";
+    CHECK(stream.str() == "Just([\"a\"])!");
+  }
+}
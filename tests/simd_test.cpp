@@ -0,0 +1,147 @@
+#include "lazystream.hpp"
+#include "simd.hpp"
+#include "stream.hpp"
+#include <doctest/doctest.h>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+namespace {
+using caskell::impl::simd::Isa;
+using caskell::impl::simd::Kind;
+
+// Every instruction set the running CPU can execute, narrowest first.
+std::vector<Isa> supportedIsas() {
+  std::vector<Isa> result;
+  for (Isa isa : {Isa::Scalar, Isa::SSE2, Isa::AVX2, Isa::AVX512})
+    if (isa <= caskell::impl::simd::isa())
+      result.push_back(isa);
+  return result;
+}
+
+template <typename T> std::vector<T> sample(std::size_t n) {
+  std::vector<T> values(n);
+  for (std::size_t i = 0; i < n; ++i)
+    values[i] = static_cast<T>((i * 37 + 11) % 101) - static_cast<T>(50);
+  return values;
+}
+} // namespace
+
+TEST_CASE("SIMD kernels") {
+  SUBCASE("Integer kernels match the scalar fold on every ISA") {
+    for (std::size_t n : {0u, 1u, 7u, 63u, 64u, 1000u, 4099u}) {
+      auto values = sample<std::int32_t>(n);
+      auto other = sample<std::int32_t>(n + 3);
+      std::int32_t sum = std::accumulate(values.begin(), values.end(), 0);
+      std::int32_t dot = 0;
+      std::size_t below = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+        dot += values[i] * other[i];
+        below += values[i] < 7;
+      }
+      for (Isa isa : supportedIsas()) {
+        using caskell::impl::simd::Compare;
+        using caskell::impl::simd::run;
+        CHECK(run<Kind::Sum>(values.data(), nullptr, n, 0, isa) == sum);
+        CHECK(run<Kind::Dot>(values.data(), other.data(), n, 0, isa) == dot);
+        CHECK(run<Kind::CountIf, Compare::Less>(values.data(), nullptr, n, 7,
+                                                isa)
+              == below);
+        if (n > 0) {
+          CHECK(run<Kind::Min>(values.data(), nullptr, n, 0, isa)
+                == *std::min_element(values.begin(), values.end()));
+          CHECK(run<Kind::Max>(values.data(), nullptr, n, 0, isa)
+                == *std::max_element(values.begin(), values.end()));
+        }
+      }
+    }
+  }
+
+  SUBCASE("Narrow lane counters do not overflow") {
+    std::vector<std::int8_t> values(100000, 1);
+    for (Isa isa : supportedIsas()) {
+      CHECK(caskell::impl::simd::run<Kind::CountIf,
+                                     caskell::impl::simd::Compare::Equal>(
+                values.data(), nullptr, values.size(), std::int8_t(1), isa)
+            == values.size());
+    }
+  }
+
+  SUBCASE("Floating-point kernels stay close to the left fold") {
+    auto values = sample<double>(5000);
+    double sum = std::accumulate(values.begin(), values.end(), 0.0);
+    for (Isa isa : supportedIsas()) {
+      double total = caskell::impl::simd::run<Kind::Sum>(
+          values.data(), nullptr, values.size(), 0.0, isa);
+      CHECK(std::abs(total - sum) < 1e-9);
+    }
+  }
+}
+
+TEST_CASE("SIMD reductions through streams") {
+  using caskell::reassociate;
+  namespace ops = caskell::ops;
+
+  SUBCASE("Dispatch needs opt-in for floating point only") {
+    using caskell::impl::simd::Vectorizable;
+    static_assert(Vectorizable<std::plus<>, int, int>);
+    static_assert(Vectorizable<ops::Max, long, long>);
+    static_assert(!Vectorizable<std::plus<>, double, double>);
+    static_assert(Vectorizable<caskell::Reassociate<ops::Sum>, double, double>);
+    static_assert(!Vectorizable<std::plus<>, long, int>);
+    static_assert(Vectorizable<std::plus<long>, long, long>);
+    static_assert(!Vectorizable<std::plus<int>, long, long>);
+    static_assert(!Vectorizable<ops::Dot, double, double>);
+    static_assert(Vectorizable<ops::CountIf<std::less<>, double>, int, double>);
+  }
+
+  SUBCASE("Stream reduce") {
+    auto values = sample<int>(10000);
+    int expected = std::accumulate(values.begin(), values.end(), 5);
+    CHECK(caskell::stream(std::vector<int>(values)).reduce(std::plus<>(), 5)
+          == expected);
+    std::vector<long> wide(1000, 1L << 32);
+    CHECK(caskell::stream(std::move(wide)).reduce(std::plus<int>(), 0L)
+          == 0);
+    CHECK(caskell::stream(std::vector<int>(values)).reduce(ops::min, 0)
+          == -50);
+    CHECK(caskell::stream(std::vector<int>(values))
+              .map([](int x) { return x * 2; })
+              .reduce(ops::max, -1000)
+          == 100);
+    CHECK(caskell::stream(std::vector<int>(values))
+              .par()
+              .reduce(ops::countIf(std::greater_equal<>(), 0), 1)
+          == 1 + std::count_if(values.begin(), values.end(),
+                               [](int x) { return x >= 0; }));
+  }
+
+  SUBCASE("Reassociated floating-point sums") {
+    std::vector<double> values(10000, 0.25);
+    CHECK(caskell::stream(std::vector<double>(values))
+              .reduce(reassociate(ops::sum), 1.0)
+          == 2501.0);
+    CHECK(caskell::stream(std::vector<double>(values))
+              .par()
+              .reduce(reassociate(ops::sum), 1.0)
+          == 2501.0);
+    CHECK(caskell::dot(values, values, reassociate(ops::dot)) == 625.0);
+    CHECK(caskell::dot(values, values) == 625.0);
+  }
+
+  SUBCASE("LazyStream reduce") {
+    auto total = caskell::LazyStream(caskell::RangeGenerator<long>(0))
+                     .filter([](long x) { return x % 3 == 0; })
+                     .take(1000)
+                     .reduce(0L, ops::sum);
+    CHECK(total == 3 * 999L * 1000 / 2);
+    auto values = sample<float>(3000);
+    auto stream = caskell::LazyStream(caskell::ContainerGenerator(values));
+    CHECK(stream.reduce(0, ops::countIf(std::less<>(), 0.0f))
+          == std::count_if(values.begin(), values.end(),
+                           [](float x) { return x < 0; }));
+    CHECK(stream.reduce(100.0f, reassociate(ops::min)) == -50.0f);
+  }
+}
@@ -0,0 +1,103 @@
+#include "soa.hpp"
+#include "stream.hpp"
+#include <doctest/doctest.h>
+#include <string>
+#include <vector>
+
+namespace {
+struct Trade {
+  int id = 0;
+  double price = 0;
+  int quantity = 0;
+  std::string venue;
+
+  bool operator==(const Trade &other) const {
+    return id == other.id && price == other.price
+           && quantity == other.quantity && venue == other.venue;
+  }
+};
+
+using Trades = caskell::SoA<Trade, &Trade::id, &Trade::price,
+                            &Trade::quantity, &Trade::venue>;
+
+Trades sampleTrades() {
+  return Trades{{1, 10.5, 3, "X"}, {2, 99.0, 1, "Y"}, {3, 12.0, 7, "X"}};
+}
+} // namespace
+
+TEST_CASE("SoA container") {
+  SUBCASE("Rows round-trip through the columns") {
+    auto trades = sampleTrades();
+    CHECK(trades.size() == 3);
+    CHECK(trades.column<&Trade::price>() == std::vector<double>{10.5, 99, 12});
+    Trade second = trades[1];
+    CHECK(second == Trade{2, 99.0, 1, "Y"});
+    trades[0] = Trade{9, 1.0, 1, "Z"};
+    CHECK(caskell::get<&Trade::venue>(trades[0]) == "Z");
+    CHECK(Trades::fromAoS(trades.toAoS()) == trades);
+  }
+
+  SUBCASE("Projections read single columns") {
+    auto notional = caskell::stream(sampleTrades())
+                        .map([](const auto &t) {
+                          return caskell::get<&Trade::price>(t)
+                                 * caskell::get<&Trade::quantity>(t);
+                        })
+                        .collect();
+    static_assert(std::is_same_v<decltype(notional), caskell::SoA<double>>);
+    CHECK(notional == caskell::SoA<double>{31.5, 99.0, 84.0});
+  }
+
+  SUBCASE("Filtering keeps the SoA layout") {
+    auto onX = caskell::stream(sampleTrades())
+                   .filter([](const auto &t) {
+                     return caskell::get<&Trade::venue>(t) == "X";
+                   })
+                   .collect();
+    static_assert(std::is_same_v<decltype(onX), Trades>);
+    REQUIRE(onX.size() == 2);
+    CHECK(onX.column<&Trade::id>() == std::vector<int>{1, 3});
+  }
+
+  SUBCASE("Eager filtering compacts the columns in place") {
+    auto trades = sampleTrades();
+    auto cheap = caskell::stream(std::move(trades))
+                     .eager()
+                     .filter([](const auto &t) {
+                       return caskell::get<&Trade::price>(t) < 50;
+                     })
+                     .collect();
+    static_assert(std::is_same_v<decltype(cheap), Trades>);
+    CHECK(cheap.toAoS()
+          == std::vector<Trade>{{1, 10.5, 3, "X"}, {3, 12.0, 7, "X"}});
+    Trades::const_iterator first = cheap.begin();
+    CHECK(first == cheap.begin());
+  }
+
+  SUBCASE("collect rebuilds array-of-structs output") {
+    auto records = caskell::stream(sampleTrades())
+                       .filter([](const Trade &t) { return t.quantity > 1; })
+                       .collect<std::vector<Trade>>();
+    CHECK(records
+          == std::vector<Trade>{{1, 10.5, 3, "X"}, {3, 12.0, 7, "X"}});
+    auto all = caskell::stream(sampleTrades()).collect<std::vector<Trade>>();
+    CHECK(all == sampleTrades().toAoS());
+  }
+
+  SUBCASE("Parallel and hash operations accept SoA streams") {
+    auto ids = caskell::stream(sampleTrades())
+                   .par()
+                   .filter([](const auto &t) {
+                     return caskell::get<&Trade::price>(t) < 50;
+                   })
+                   .collect();
+    CHECK(ids.column<&Trade::id>() == std::vector<int>{1, 3});
+    auto byVenue = caskell::stream(sampleTrades())
+                       .groupBy([](const auto &t) {
+                         return caskell::get<&Trade::venue>(t);
+                       })
+                       .collect();
+    REQUIRE(byVenue.size() == 2);
+    CHECK(byVenue[0].second.column<&Trade::id>() == std::vector<int>{1, 3});
+  }
+}
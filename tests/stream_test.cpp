@@ -0,0 +1,450 @@
+#include "flat_hash_map.hpp"
+#include "stream.hpp"
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+// Counts copies so tests can assert that rvalue chains only move.
+struct Tracked {
+  static inline std::size_t copies = 0;
+  std::string text;
+
+  Tracked() = default;
+  explicit Tracked(std::string s) : text(std::move(s)) {}
+  Tracked(const Tracked &other) : text(other.text) { ++copies; }
+  Tracked(Tracked &&) = default;
+  Tracked &operator=(const Tracked &other) {
+    text = other.text;
+    ++copies;
+    return *this;
+  }
+  Tracked &operator=(Tracked &&) = default;
+};
+
+std::vector<Tracked> tracked(std::initializer_list<const char *> words) {
+  std::vector<Tracked> result;
+  result.reserve(words.size());
+  for (const char *word : words)
+    result.emplace_back(word);
+  return result;
+}
+} // namespace
+
+TEST_CASE("Stream fused pipelines") {
+  SUBCASE("Stages run in one pass on collect") {
+    std::vector<int> trace;
+    auto result = caskell::stream(std::vector<int>{1, 2, 3, 4})
+                      .map([&](int x) {
+                        trace.push_back(x);
+                        return x * 10;
+                      })
+                      .filter([&](int x) {
+                        trace.push_back(-x);
+                        return x != 20;
+                      })
+                      .map([](int x) { return std::to_string(x); })
+                      .collect();
+    CHECK(result == std::vector<std::string>{"10", "30", "40"});
+    CHECK(trace == std::vector<int>{1, -10, 2, -20, 3, -30, 4, -40});
+  }
+
+  SUBCASE("Nothing runs before a terminal operation") {
+    int calls = 0;
+    const auto source = caskell::stream(std::vector<int>{1, 2, 3});
+    auto pipeline = source.map([&](int x) {
+      ++calls;
+      return x + 1;
+    });
+    CHECK(calls == 0);
+    CHECK(pipeline.reduce([](int a, int b) { return a + b; }, 0) == 9);
+    CHECK(calls == 3);
+    CHECK(source.collect() == std::vector<int>{1, 2, 3});
+  }
+
+  SUBCASE("Pipelines over temporaries own their source") {
+    auto pipeline = caskell::stream(std::vector<int>{5, 6, 7, 8})
+                        .filter([](int x) { return x % 2 == 0; });
+    auto doubled = pipeline.map([](int x) { return x * 2; });
+    CHECK(doubled.collect() == std::vector<int>{12, 16});
+    CHECK(pipeline.collect() == std::vector<int>{6, 8});
+  }
+
+  SUBCASE("Mutable lvalue streams filter and map in place") {
+    auto s = caskell::stream(std::vector<int>{1, 2, 3, 4});
+    s.filter([](int x) { return x % 2 == 0; });
+    s.map([](int x) { return x + 1; });
+    CHECK(s.collect() == std::vector<int>{3, 5});
+    auto names = s.map([](int x) { return std::to_string(x); }).collect();
+    CHECK(names == std::vector<std::string>{"3", "5"});
+    CHECK(s.collect() == std::vector<int>{3, 5});
+  }
+
+  SUBCASE("Pipelines from const streams copy, views borrow") {
+    auto makePipeline = [] {
+      const auto s = caskell::stream(std::vector<int>{1, 2, 3});
+      return s.filter([](int x) { return x != 2; });
+    };
+    CHECK(makePipeline().collect() == std::vector<int>{1, 3});
+
+    const auto words = caskell::stream(tracked({"a", "bb"}));
+    Tracked::copies = 0;
+    auto lengths = words.view()
+                       .map([](const Tracked &t) { return t.text.size(); })
+                       .collect();
+    CHECK(Tracked::copies == 0);
+    CHECK(lengths == std::vector<std::size_t>{1, 2});
+  }
+
+  SUBCASE("Extending a named pipeline copies an owned source") {
+    auto extend = [] {
+      auto pipeline = caskell::stream(std::vector<int>{1, 2, 3, 4})
+                          .filter([](int x) { return x % 2 == 0; });
+      return pipeline.map([](int x) { return x * 10; });
+    };
+    CHECK(extend().collect() == std::vector<int>{20, 40});
+
+    const auto words = caskell::stream(tracked({"a", "bb", "ccc"}));
+    auto view = words.view().map([](const Tracked &t) { return t; });
+    Tracked::copies = 0;
+    auto longer = view.filter([](const Tracked &t) {
+      return t.text.size() > 1;
+    });
+    CHECK(Tracked::copies == 0);
+    CHECK(longer.collect().size() == 2);
+  }
+
+  SUBCASE("Filtered collects allocate the bound once and trim it") {
+    const auto s = caskell::stream(std::vector<int>(100'000, 0));
+    auto none = s.view().filter([](int x) { return x != 0; }).collect();
+    CHECK(none.empty());
+    CHECK(none.capacity() < 50'000);
+    auto most = s.view().filter([](int x) { return x == 0; }).collect();
+    CHECK(most.capacity() == 100'000);
+    auto all = s.view().map([](int x) { return x + 1; }).collect();
+    CHECK(all.capacity() == 100'000);
+  }
+
+  SUBCASE("Collect rebinds non-vector containers") {
+    auto result = caskell::stream(std::list<int>{3, 1, 2})
+                      .map([](int x) { return x * 0.5; })
+                      .collect();
+    CHECK(result == std::list<double>{1.5, 0.5, 1.0});
+  }
+
+  SUBCASE("Eager streams keep stage-by-stage semantics") {
+    auto eager = caskell::stream(std::vector<int>{1, 2, 3, 4}).eager();
+    eager.map([](int x) { return x * x; });
+    eager.filter([](int x) { return x > 4; });
+    CHECK(eager.collect() == std::vector<int>{9, 16});
+  }
+}
+
+TEST_CASE("Stream rvalue chains") {
+  SUBCASE("Fused pipelines compact in place") {
+    auto words = tracked({"a", "bb", "ccc", "dd", "e"});
+    const Tracked *buffer = words.data();
+    Tracked::copies = 0;
+    auto result = caskell::stream(std::move(words))
+                      .filter([](const Tracked &t) {
+                        return t.text.size() > 1;
+                      })
+                      .map([](Tracked t) {
+                        t.text += "!";
+                        return t;
+                      })
+                      .collect();
+    CHECK(Tracked::copies == 0);
+    CHECK(result.data() == buffer);
+    REQUIRE(result.size() == 3);
+    CHECK(result[0].text == "bb!");
+    CHECK(result[1].text == "ccc!");
+    CHECK(result[2].text == "dd!");
+  }
+
+  SUBCASE("Eager rvalue chains move the container along") {
+    auto words = tracked({"x", "yy", "zzz"});
+    const Tracked *buffer = words.data();
+    Tracked::copies = 0;
+    auto result = caskell::stream(std::move(words))
+                      .eager()
+                      .filter([](const Tracked &t) { return t.text != "yy"; })
+                      .map([](Tracked t) {
+                        t.text += t.text;
+                        return t;
+                      })
+                      .collect();
+    CHECK(Tracked::copies == 0);
+    CHECK(result.data() == buffer);
+    REQUIRE(result.size() == 2);
+    CHECK(result[0].text == "xx");
+    CHECK(result[1].text == "zzzzzz");
+  }
+
+  SUBCASE("Type-changing rvalue maps move elements out") {
+    auto words = tracked({"one", "three"});
+    Tracked::copies = 0;
+    auto lengths = caskell::stream(std::move(words))
+                       .eager()
+                       .map([](Tracked t) { return t.text.size(); })
+                       .collect();
+    CHECK(Tracked::copies == 0);
+    CHECK(lengths == std::vector<std::size_t>{3, 5});
+  }
+}
+
+TEST_CASE("Stream parallel execution") {
+  std::vector<long> values(100000);
+  std::iota(values.begin(), values.end(), 0);
+
+  SUBCASE("Map writes every element in order") {
+    auto result = caskell::stream(std::vector<long>(values))
+                      .par()
+                      .map([](long x) { return x % 7 == 0; })
+                      .collect();
+    std::vector<bool> expected;
+    for (long x : values)
+      expected.push_back(x % 7 == 0);
+    CHECK(result == expected);
+  }
+
+  SUBCASE("Filter keeps survivors in source order") {
+    const auto source = caskell::stream(std::vector<long>(values)).par();
+    auto result = source.filter([](long x) { return x % 3 == 1; }).collect();
+    std::vector<long> expected;
+    for (long x = 1; x < 100000; x += 3)
+      expected.push_back(x);
+    CHECK(result == expected);
+    CHECK(source.size() == values.size());
+  }
+
+  SUBCASE("Reduce folds init in once") {
+    auto sum = caskell::stream(std::vector<long>(values))
+                   .par()
+                   .reduce([](long a, long b) { return a + b; }, 10);
+    CHECK(sum == 10 + 99999L * 100000 / 2);
+    auto order = caskell::stream(std::vector<std::string>{"a", "b", "c"})
+                     .par()
+                     .reduce([](std::string a, std::string b) { return a + b; },
+                             ">");
+    CHECK(order == ">abc");
+  }
+
+  SUBCASE("Rvalue streams move strings through the chain") {
+    auto words = tracked({"one", "two", "three", "four"});
+    Tracked::copies = 0;
+    auto result = caskell::stream(std::move(words))
+                      .par()
+                      .map([](Tracked t) {
+                        t.text += "s";
+                        return t;
+                      })
+                      .filter([](const Tracked &t) { return t.text != "twos"; })
+                      .seq()
+                      .collect();
+    CHECK(Tracked::copies == 0);
+    REQUIRE(result.size() == 3);
+    CHECK(result[2].text == "fours");
+  }
+
+  SUBCASE("forEach visits every element") {
+    std::vector<int> seen(values.size());
+    caskell::stream(std::vector<long>(values)).par().forEach([&](long x) {
+      seen[x] = 1;
+    });
+    CHECK(std::accumulate(seen.begin(), seen.end(), 0) == 100000);
+  }
+}
+
+TEST_CASE("FlatHashMap") {
+  caskell::impl::FlatHashMap<int, std::string> map;
+  std::size_t inserted = 0;
+  for (int i = 0; i < 1000; ++i)
+    inserted += map.tryEmplace(i * 7, std::to_string(i)).second;
+  CHECK(inserted == 1000);
+  CHECK_FALSE(map.tryEmplace(7, "again").second);
+  CHECK(map.size() == 1000);
+  REQUIRE(map.find(7 * 999) != nullptr);
+  CHECK(*map.find(7 * 999) == "999");
+  CHECK(map.find(3) == nullptr);
+  map[3] += "three";
+  CHECK(*map.find(3) == "three");
+  auto entries = std::move(map).release();
+  CHECK(entries.front().first == 0);
+  CHECK(entries.back().first == 3);
+}
+
+TEST_CASE("Stream relational operations") {
+  using Sale = std::pair<std::string, int>;
+  std::vector<Sale> sales{{"pear", 3}, {"fig", 1}, {"pear", 4},
+                          {"kiwi", 2}, {"fig", 5}, {"pear", 1}};
+  auto fruit = [](const Sale &sale) { return sale.first; };
+
+  SUBCASE("groupBy keeps first-occurrence and source order") {
+    auto groups = caskell::stream(std::vector<Sale>(sales))
+                      .groupBy(fruit)
+                      .collect();
+    REQUIRE(groups.size() == 3);
+    CHECK(groups[0].first == "pear");
+    CHECK(groups[0].second
+          == std::vector<Sale>{{"pear", 3}, {"pear", 4}, {"pear", 1}});
+    CHECK(groups[1].first == "fig");
+    CHECK(groups[2].second == std::vector<Sale>{{"kiwi", 2}});
+  }
+
+  SUBCASE("reduceByKey folds each key") {
+    auto totals = caskell::stream(std::vector<Sale>(sales))
+                      .reduceByKey(fruit,
+                                   [](Sale acc, const Sale &sale) {
+                                     acc.second += sale.second;
+                                     return acc;
+                                   })
+                      .collect();
+    REQUIRE(totals.size() == 3);
+    CHECK(totals[0].second.second == 8);
+    CHECK(totals[1].second.second == 6);
+    CHECK(totals[2].second.second == 2);
+  }
+
+  SUBCASE("distinct keeps first occurrences") {
+    auto unique = caskell::stream(std::vector<int>{4, 1, 4, 2, 1, 3, 2})
+                      .distinct()
+                      .collect();
+    CHECK(unique == std::vector<int>{4, 1, 2, 3});
+  }
+
+  SUBCASE("hashJoin pairs every match") {
+    std::vector<std::pair<std::string, double>> prices{
+        {"fig", 0.5}, {"pear", 1.5}, {"fig", 0.75}};
+    auto joined = caskell::stream(std::vector<Sale>(sales))
+                      .hashJoin(prices, fruit,
+                                [](const auto &price) { return price.first; })
+                      .collect();
+    REQUIRE(joined.size() == 7);
+    CHECK(joined[0].first == Sale{"pear", 3});
+    CHECK(joined[0].second.second == 1.5);
+    CHECK(joined[1].first == Sale{"fig", 1});
+    CHECK(joined[1].second.second == 0.5);
+    CHECK(joined[2].second.second == 0.75);
+  }
+
+  SUBCASE("Parallel streams give the sequential results") {
+    std::vector<int> values(50000);
+    for (std::size_t i = 0; i < values.size(); ++i)
+      values[i] = static_cast<int>((i * 7919) % 1000);
+    auto bucket = [](int x) { return x % 17; };
+    auto sum = [](int a, int b) { return a + b; };
+
+    auto seq = caskell::stream(std::vector<int>(values));
+    auto par = caskell::stream(std::vector<int>(values)).par();
+    CHECK(par.groupBy(bucket).collect() == seq.groupBy(bucket).collect());
+    CHECK(par.reduceByKey(bucket, sum).collect()
+          == seq.reduceByKey(bucket, sum).collect());
+    CHECK(par.distinct().collect() == seq.distinct().collect());
+
+    std::vector<int> keys{5, 16, 5, 99};
+    auto identity = [](int x) { return x; };
+    CHECK(par.hashJoin(keys, bucket, identity).collect()
+          == seq.hashJoin(keys, bucket, identity).collect());
+  }
+}
+
+TEST_CASE("Stream ordering operations") {
+  // Pseudo-random values with many duplicates and both signs.
+  std::vector<int> values(2000);
+  for (std::size_t i = 0; i < values.size(); ++i)
+    values[i] = static_cast<int>((i * 7919) % 1009) - 500;
+  auto byValue = [](int x) { return x; };
+
+  SUBCASE("sortBy matches std::stable_sort for radix and generic keys") {
+    for (std::size_t n : {std::size_t(10), values.size()}) {
+      std::vector<int> input(values.begin(), values.begin() + n);
+      std::vector<int> expected = input;
+      std::stable_sort(expected.begin(), expected.end());
+      CHECK(caskell::stream(std::vector<int>(input)).sortBy(byValue).collect()
+            == expected);
+
+      std::stable_sort(expected.begin(), expected.end(), std::greater<>());
+      CHECK(caskell::stream(std::vector<int>(input))
+                .sortBy(byValue, std::greater<>())
+                .collect()
+            == expected);
+    }
+
+    std::vector<double> reals{2.5, -0.0, -7.25, 0.0, 1e300, -1e-300, 3.0};
+    reals.resize(600, 1.5);
+    std::vector<double> expected = reals;
+    std::stable_sort(expected.begin(), expected.end());
+    auto sorted = caskell::stream(std::vector<double>(reals))
+                      .sortBy([](double x) { return x; })
+                      .collect();
+    CHECK(sorted == expected);
+    CHECK(std::signbit(sorted[2]));
+    CHECK(!std::signbit(sorted[3]));
+  }
+
+  SUBCASE("Equal keys keep their source order") {
+    std::vector<std::pair<int, std::size_t>> pairs;
+    for (std::size_t i = 0; i < values.size(); ++i)
+      pairs.emplace_back(values[i] % 7, i);
+    auto sorted = caskell::stream(std::move(pairs))
+                      .sortBy([](const auto &p) { return p.first; })
+                      .collect();
+    CHECK(std::is_sorted(sorted.begin(), sorted.end()));
+
+    std::list<std::string> words{"pear", "fig", "apple", "kiwi", "plum"};
+    auto bySize = caskell::stream(std::move(words))
+                      .sortBy([](const std::string &w) { return w.size(); })
+                      .collect();
+    CHECK(bySize
+          == std::list<std::string>{"fig", "pear", "kiwi", "plum", "apple"});
+  }
+
+  SUBCASE("topK is the prefix of sortBy") {
+    const auto s = caskell::stream(std::vector<int>(values));
+    auto sorted = s.sortBy(byValue).collect();
+    for (std::size_t k : {std::size_t(0), std::size_t(1), std::size_t(17),
+                          values.size(), values.size() + 5}) {
+      std::vector<int> prefix(sorted.begin(),
+                              sorted.begin() + std::min(k, sorted.size()));
+      CHECK(s.topK(k, byValue).collect() == prefix);
+    }
+    auto largest = s.topK(3, byValue, std::greater<>()).collect();
+    CHECK(largest == std::vector<int>{508, 508, 507});
+  }
+
+  SUBCASE("Pipelines select their top elements in one pass") {
+    auto evens = caskell::stream(std::vector<int>(values))
+                     .filter([](int x) { return x % 2 == 0; })
+                     .map([](int x) { return x * 10; });
+    auto top = evens.topK(4, [](int x) { return -x; });
+    CHECK(top.collect() == std::vector<int>{5080, 5080, 5060, 5060});
+    auto ascending = evens.sortBy(byValue).collect();
+    CHECK(std::is_sorted(ascending.begin(), ascending.end()));
+    CHECK(ascending.back() == 5080);
+  }
+
+  SUBCASE("Rvalue streams move their elements") {
+    auto words = tracked({"delta", "alpha", "charlie", "bravo"});
+    Tracked::copies = 0;
+    auto key = [](const Tracked &t) { return t.text; };
+    auto sorted = caskell::stream(std::move(words)).sortBy(key).collect();
+    auto first = caskell::stream(std::move(sorted)).topK(2, key).collect();
+    auto size = [](const Tracked &t) { return t.text.size(); };
+    auto shortest = caskell::stream(tracked({"ccc", "a", "bb"}))
+                        .filter([](const Tracked &) { return true; })
+                        .topK(1, size);
+    CHECK(Tracked::copies == 0);
+    REQUIRE(first.size() == 2);
+    CHECK(first[0].text == "alpha");
+    CHECK(first[1].text == "bravo");
+    CHECK(shortest[0].text == "a");
+  }
+}